@@ -0,0 +1,407 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sudokucpp/sudoku.h"
+#include "sudokucpp/batch.h"
+#include "sudokucpp/canonical.h"
+#include "sudokucpp/combinations.h"
+#include "sudokucpp/eliminators.h"
+#include "sudokucpp/engine.h"
+#include "sudokucpp/grid.h"
+#include "sudokucpp/parallel.h"
+#include "sudokucpp/permutations.h"
+#include "sudokucpp/subsets.h"
+
+using namespace sudoku;
+
+namespace {
+    typedef std::chrono::steady_clock clock_type;
+
+    double min_seconds = 0.25;
+
+    // Keeps results alive so that the optimizer cannot drop the work.
+    volatile size_t sink;
+
+    struct Corpus {
+        std::string name;
+        std::vector<std::string> puzzles;
+    };
+
+    bool
+    load(
+        const char * path,
+        Corpus & corpus)
+    {
+        std::ifstream in(path);
+        std::string line;
+
+        if (!in) {
+            return false;
+        }
+
+        corpus.name = path;
+        corpus.name = corpus.name.substr(corpus.name.find_last_of('/') + 1);
+        corpus.name = corpus.name.substr(0, corpus.name.find('.'));
+
+        while (std::getline(in, line)) {
+            if (line.size() == SUDOKU_GRID_LENGTH && line[0] != '#') {
+                corpus.puzzles.push_back(line);
+            }
+        }
+
+        return true;
+    }
+
+    // Runs f(), which handles items items per call, until min_seconds
+    // have passed.  Returns nanoseconds per item.
+    template <typename F>
+    double
+    measure(
+        size_t items,
+        F f)
+    {
+        size_t rounds = 0;
+        auto start = clock_type::now();
+        std::chrono::duration<double> elapsed;
+
+        do {
+            f();
+            rounds++;
+            elapsed = clock_type::now() - start;
+        } while (elapsed.count() < min_seconds);
+
+        return elapsed.count() * 1e9 / (rounds * items);
+    }
+
+    void
+    report(
+        const std::string & name,
+        double ns,
+        const char * unit)
+    {
+        std::printf("%-40s %12.1f ns/%-7s %14.0f %s/s\n",
+                    name.c_str(), ns, unit, 1e9 / ns, unit);
+    }
+
+    void
+    bench_parsing(
+        const Corpus & corpus)
+    {
+        grid_t grid;
+        char str[SUDOKU_GRID_LENGTH];
+
+        report(corpus.name + "/parse_grid", measure(corpus.puzzles.size(), [&]() {
+            for (auto & p: corpus.puzzles) {
+                sink = parse_grid(p.data(), p.size(), grid);
+            }
+        }), "puzzle");
+
+        report(corpus.name + "/format_grid", measure(corpus.puzzles.size(), [&]() {
+            for (auto & p: corpus.puzzles) {
+                parse_grid(p.data(), p.size(), grid);
+                format_grid(grid, str);
+                sink = str[0];
+            }
+        }), "puzzle");
+    }
+
+    void
+    bench_canonical(
+        const std::string & name,
+        const std::vector<grid_t> & grids)
+    {
+        canonical::Transform transform;
+
+        report(name, measure(grids.size(), [&]() {
+            for (auto & g: grids) {
+                sink = canonical::canonicalize(g, transform)[0];
+            }
+        }), "grid");
+    }
+
+    // The puzzles and their solutions: complete grids have the most
+    // column orders to try for the first row.
+    void
+    bench_canonical(
+        const Corpus & corpus)
+    {
+        auto engine = engine::make_engine(Backend::Bitboard);
+        std::vector<grid_t> grids(corpus.puzzles.size());
+        std::vector<grid_t> solutions;
+
+        for (size_t i = 0; i < grids.size(); i++) {
+            parse_grid(corpus.puzzles[i].data(), corpus.puzzles[i].size(), grids[i]);
+
+            if (engine->solve(grids[i], 1) != 0) {
+                solutions.push_back(engine->get_solution());
+            }
+        }
+
+        bench_canonical(corpus.name + "/canonicalize", grids);
+        bench_canonical(corpus.name + "/canonicalize/complete", solutions);
+    }
+
+    // Grids with few givens, where the unsolved rows and columns keep
+    // many transforms open.
+    void
+    bench_canonical()
+    {
+        grid_t empty = {};
+        grid_t row = {};
+        grid_t three = {};
+
+        for (index_t c = 0; c < SUDOKU_NUMBERS; c++) {
+            row[c] = c + 1;
+        }
+
+        three[0] = 1;
+        three[40] = 2;
+        three[80] = 3;
+
+        bench_canonical("canonicalize/empty", { empty });
+        bench_canonical("canonicalize/one_row", { row });
+        bench_canonical("canonicalize/three_clues", { three });
+    }
+
+    void
+    bench_combinatorics()
+    {
+        size_t count = 0;
+
+        for (size_t k = 0; k <= SUDOKU_NUMBERS; k++) {
+            count += subset::subsets(SUDOKU_NUMBERS, k).size();
+        }
+
+        report("combination/Combination", measure(count - 2, [&]() {
+            for (ssize_t k = 1; k < SUDOKU_NUMBERS; k++) {
+                combination::Combination comb(SUDOKU_NUMBERS, k);
+
+                while (auto c = comb.next()) {
+                    sink = c->size();
+                }
+            }
+        }), "subset");
+
+        report("combination/MaskRange", measure(count, [&]() {
+            for (size_t k = 0; k <= SUDOKU_NUMBERS; k++) {
+                for (auto m: combination::MaskRange(SUDOKU_NUMBERS, k)) {
+                    sink = m;
+                }
+            }
+        }), "subset");
+
+        report("combination/IndexRange", measure(count, [&]() {
+            for (size_t k = 0; k <= SUDOKU_NUMBERS; k++) {
+                for (auto & c: combination::IndexRange(SUDOKU_NUMBERS, k)) {
+                    sink = c[0];
+                }
+            }
+        }), "subset");
+
+        report("combination/subset tables", measure(count, [&]() {
+            for (size_t k = 0; k <= SUDOKU_NUMBERS; k++) {
+                for (auto m: subset::subsets(SUDOKU_NUMBERS, k)) {
+                    sink = m;
+                }
+            }
+        }), "subset");
+
+        const size_t perms = permutation::factorial(SUDOKU_NUMBERS);
+
+        report("permutation/Permutation", measure(perms, [&]() {
+            permutation::Permutation perm(SUDOKU_NUMBERS);
+
+            while (auto p = perm.next()) {
+                sink = (*p)[0];
+            }
+        }), "perm");
+
+        report("permutation/FixedPermutation", measure(perms, [&]() {
+            permutation::for_each(SUDOKU_NUMBERS, [](const permutation::FixedPermutation & p) {
+                sink = p[0];
+            });
+        }), "perm");
+
+        report("permutation/rank+unrank", measure(1000, [&]() {
+            for (permutation::rank_t r = 0; r < perms; r += perms / 1000) {
+                sink = permutation::FixedPermutation::unrank(SUDOKU_NUMBERS, r).rank();
+            }
+        }), "perm");
+    }
+
+    struct Config {
+        const char * name;
+        Backend backend;
+        Strategy strategy;
+        Ordering ordering;
+    };
+
+    const Config configs[] = {
+        { "logic", Backend::Logic, Strategy::FirstHit, Ordering::Insertion },
+        { "logic-fixpoint", Backend::Logic, Strategy::Fixpoint, Ordering::Insertion },
+        { "logic-fixpoint-skip", Backend::Logic, Strategy::Fixpoint, Ordering::AdaptiveSkip },
+        { "backtracking", Backend::Backtracking, Strategy::FirstHit, Ordering::Insertion },
+        { "dancing-links", Backend::DancingLinks, Strategy::FirstHit, Ordering::Insertion },
+        { "bitboard", Backend::Bitboard, Strategy::FirstHit, Ordering::Insertion },
+        { "cdcl", Backend::Cdcl, Strategy::FirstHit, Ordering::Insertion }
+    };
+
+    void
+    bench_solver(
+        const Corpus & corpus)
+    {
+        for (auto & config: configs) {
+            auto profile = std::make_shared<eliminator::Profile>();
+            size_t solved = 0;
+
+            double ns = measure(corpus.puzzles.size(), [&]() {
+                solved = 0;
+
+                for (auto & p: corpus.puzzles) {
+                    Solver solver(p, config.backend);
+
+                    solver.set_verbose(false);
+                    solver.set_backtracking(true);
+                    solver.set_strategy(config.strategy);
+                    solver.set_ordering(config.ordering);
+                    solver.set_profile(profile);
+
+                    if (solver.solve() == Status::Solved) {
+                        solved++;
+                    }
+                }
+            });
+
+            report(corpus.name + "/Solver/" + config.name, ns, "puzzle");
+
+            if (solved != corpus.puzzles.size()) {
+                std::printf("    solved only %zu of %zu\n", solved, corpus.puzzles.size());
+            }
+
+            if (config.backend != Backend::Logic) {
+                continue;
+            }
+
+            for (auto & st: profile->statistics) {
+                if (st.calls > 0) {
+                    std::printf("    %-36s %12.1f ns/call %8.1f%% hits\n",
+                                st.name, double(st.nanoseconds) / st.calls,
+                                100.0 * st.hits / st.calls);
+                }
+            }
+        }
+
+        std::vector<grid_t> grids(corpus.puzzles.size());
+
+        for (size_t i = 0; i < grids.size(); i++) {
+            parse_grid(corpus.puzzles[i].data(), corpus.puzzles[i].size(), grids[i]);
+        }
+
+        // The engines alone, without building a Solver for every puzzle.
+        for (auto & config: configs) {
+            auto engine = engine::make_engine(config.backend);
+
+            if (!engine) {
+                continue;
+            }
+
+            report(corpus.name + "/engine/" + config.name, measure(grids.size(), [&]() {
+                for (auto & g: grids) {
+                    sink = engine->solve(g, 1);
+                }
+            }), "puzzle");
+        }
+
+        std::string records;
+
+        for (auto & p: corpus.puzzles) {
+            records += p;
+        }
+
+        std::string out(records.size(), ' ');
+
+        for (auto & config: configs) {
+            if (config.backend == Backend::Logic) {
+                continue;
+            }
+
+            BatchSolver solver(config.backend);
+
+            report(corpus.name + "/batch/" + config.name, measure(grids.size(), [&]() {
+                sink = solver.solve_batch(records.data(), grids.size(), &out[0], nullptr);
+            }), "puzzle");
+        }
+
+        ParallelBatchSolver pool;
+
+        report(corpus.name + "/parallel/bitboard x" + std::to_string(pool.get_threads()),
+               measure(grids.size(), [&]() {
+                   sink = pool.solve_batch(records.data(), grids.size(), &out[0], nullptr);
+               }), "puzzle");
+    }
+}
+
+int
+main(
+    int argc,
+    char ** argv)
+{
+    std::vector<Corpus> corpora;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            min_seconds = std::atof(argv[++i]);
+            continue;
+        }
+
+        Corpus corpus;
+
+        if (!load(argv[i], corpus)) {
+            std::cerr << "Cannot read " << argv[i] << std::endl;
+            return 1;
+        }
+
+        corpora.push_back(corpus);
+    }
+
+    if (corpora.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-t seconds] corpus..." << std::endl;
+        return 1;
+    }
+
+    bench_combinatorics();
+    bench_canonical();
+
+    for (auto & corpus: corpora) {
+        bench_parsing(corpus);
+        bench_canonical(corpus);
+    }
+
+    for (auto & corpus: corpora) {
+        bench_solver(corpus);
+    }
+
+    return 0;
+}
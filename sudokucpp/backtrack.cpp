@@ -0,0 +1,318 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "config.h"
+#include "backtrack.h"
+
+using namespace sudoku;
+using namespace sudoku::backtrack;
+
+Backtracker::Backtracker() : nodes(0)
+{
+    this->solution.fill(0);
+}
+
+size_t
+Backtracker::solve(
+    const grid_t & values,
+    size_t limit)
+{
+    SUDOKU_TRACE("Backtracker::solve");
+
+    this->nodes = 0;
+
+    if (!load(this->stack[0].state, values, nullptr)) {
+        return 0;
+    }
+
+    return search(limit);
+}
+
+size_t
+Backtracker::solve(
+    const grid_t & values,
+    const masks_t & candidates,
+    size_t limit)
+{
+    SUDOKU_TRACE("Backtracker::solve");
+
+    this->nodes = 0;
+
+    if (!load(this->stack[0].state, values, &candidates)) {
+        return 0;
+    }
+
+    return search(limit);
+}
+
+bool
+Backtracker::load(
+    State & s,
+    const grid_t & values,
+    const masks_t * candidates) const
+{
+    s.unsolved = SUDOKU_GRID_LENGTH;
+    s.values.fill(0);
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        if (values[i] == 0 && candidates != nullptr) {
+            s.candidates[i] = (*candidates)[i] & ALL_CANDIDATES;
+
+            if (s.candidates[i] == 0) {
+                return false;
+            }
+        } else {
+            s.candidates[i] = ALL_CANDIDATES;
+        }
+    }
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        if (values[i] > SUDOKU_NUMBERS) {
+            return false;
+        }
+
+        if (values[i] != 0 && !assign(s, i, values[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+Backtracker::set_value(
+    State & s,
+    index_t cell,
+    index_t number,
+    index_t * queue,
+    size_t & tail) const
+{
+    if (s.values[cell] != 0) {
+        return s.values[cell] == number;
+    }
+
+    mask_t bit = number_mask(number);
+
+    if ((s.candidates[cell] & bit) == 0) {
+        return false;
+    }
+
+    s.values[cell] = number;
+    s.candidates[cell] = bit;
+    s.unsolved--;
+
+    for (auto p: grid::tables.peers[cell]) {
+        mask_t m = s.candidates[p];
+
+        if ((m & bit) == 0) {
+            continue;
+        }
+
+        if (s.values[p] != 0) {
+            return false;
+        }
+
+        m &= ~bit;
+        s.candidates[p] = m;
+
+        if (m == 0) {
+            return false;
+        }
+
+        if ((m & (m - 1)) == 0) {
+            queue[tail++] = p;
+        }
+    }
+
+    return true;
+}
+
+bool
+Backtracker::assign(
+    State & s,
+    index_t cell,
+    index_t number) const
+{
+    index_t queue[SUDOKU_GRID_LENGTH];
+    size_t head = 0;
+    size_t tail = 0;
+
+    if (!set_value(s, cell, number, queue, tail)) {
+        return false;
+    }
+
+    while (head < tail) {
+        auto p = queue[head++];
+
+        if (s.values[p] == 0
+            && !set_value(s, p, mask_number(s.candidates[p]), queue, tail)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+Backtracker::propagate(
+    State & s) const
+{
+    bool changed = true;
+
+    while (changed && s.unsolved > 0) {
+        changed = false;
+
+        for (auto & house: grid::tables.houses) {
+            mask_t once = 0;
+            mask_t twice = 0;
+            mask_t solved = 0;
+
+            for (auto i: house) {
+                mask_t m = s.candidates[i];
+
+                twice |= once & m;
+                once |= m;
+
+                if (s.values[i] != 0) {
+                    solved |= m;
+                }
+            }
+
+            if (once != ALL_CANDIDATES) {
+                return false;
+            }
+
+            mask_t singles = once & ~twice & ~solved;
+
+            while (singles != 0) {
+                mask_t bit = singles & -singles;
+                singles ^= bit;
+
+                bool found = false;
+
+                for (auto i: house) {
+                    if (s.candidates[i] & bit) {
+                        if (!assign(s, i, mask_number(bit))) {
+                            return false;
+                        }
+                        found = true;
+                        break;
+                    }
+                }
+
+                if (!found) {
+                    return false;
+                }
+
+                changed = true;
+            }
+        }
+    }
+
+    return true;
+}
+
+index_t
+Backtracker::choose(
+    const State & s) const
+{
+    index_t best = 0;
+    index_t best_count = SUDOKU_NUMBERS + 1;
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        if (s.values[i] != 0) {
+            continue;
+        }
+
+        auto n = mask_count(s.candidates[i]);
+
+        if (n < best_count) {
+            best = i;
+            best_count = n;
+
+            if (n <= 2) {
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+size_t
+Backtracker::search(
+    size_t limit)
+{
+    size_t count = 0;
+    Frame & root = this->stack[0];
+
+    if (!propagate(root.state)) {
+        return 0;
+    }
+
+    if (root.state.unsolved == 0) {
+        this->solution = root.state.values;
+        return 1;
+    }
+
+    root.cell = choose(root.state);
+    root.untried = root.state.candidates[root.cell];
+
+    ssize_t depth = 0;
+
+    while (depth >= 0) {
+        Frame & f = this->stack[depth];
+
+        if (f.untried == 0) {
+            depth--;
+            continue;
+        }
+
+        if (interrupted()) {
+            break;
+        }
+
+        mask_t bit = f.untried & -f.untried;
+        f.untried ^= bit;
+        this->nodes++;
+
+        Frame & next = this->stack[depth + 1];
+        next.state = f.state;
+
+        if (!assign(next.state, f.cell, mask_number(bit)) || !propagate(next.state)) {
+            continue;
+        }
+
+        if (next.state.unsolved == 0) {
+            if (count == 0) {
+                this->solution = next.state.values;
+            }
+
+            count++;
+
+            if (count >= limit) {
+                break;
+            }
+            continue;
+        }
+
+        next.cell = choose(next.state);
+        next.untried = next.state.candidates[next.cell];
+        depth++;
+    }
+
+    return count;
+}
@@ -0,0 +1,78 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef BACKTRACK_H
+#define BACKTRACK_H
+
+#include "engine.h"
+
+namespace sudoku {
+    namespace backtrack {
+        // Depth-first search that branches on the cell with the fewest
+        // candidates (MRV) and propagates naked and hidden singles at every
+        // node.  Each level works on its own copy of the bitmask state kept
+        // in a fixed-size stack, so searching does not allocate.
+        class Backtracker : public engine::Engine
+        {
+        public:
+            Backtracker();
+
+            // Search from the given cell values; returns the number of
+            // solutions found, stopping once limit solutions have been seen.
+            virtual size_t solve(const grid_t & values, size_t limit = 2);
+
+            // As above, but unsolved cells start from the given candidates.
+            size_t solve(const grid_t & values, const masks_t & candidates,
+                         size_t limit = 2);
+
+            // The first solution found by the last successful solve().
+            virtual const grid_t & get_solution() const {
+                return this->solution;
+            }
+
+            size_t get_nodes() const {
+                return this->nodes;
+            }
+
+        private:
+            struct State {
+                masks_t candidates;
+                grid_t values;
+                index_t unsolved;
+            };
+
+            struct Frame {
+                State state;
+                index_t cell;
+                mask_t untried;
+            };
+
+            bool load(State & s, const grid_t & values, const masks_t * candidates) const;
+            bool set_value(State & s, index_t cell, index_t number,
+                           index_t * queue, size_t & tail) const;
+            bool assign(State & s, index_t cell, index_t number) const;
+            bool propagate(State & s) const;
+            index_t choose(const State & s) const;
+            size_t search(size_t limit);
+
+            Frame stack[SUDOKU_GRID_LENGTH + 1];
+            grid_t solution;
+            size_t nodes;
+        };
+    }
+}
+
+#endif
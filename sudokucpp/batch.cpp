@@ -0,0 +1,133 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+
+#include "config.h"
+#include "batch.h"
+
+using namespace sudoku;
+
+BatchSolver::BatchSolver(
+    Backend backend) : backend(backend), engine(engine::make_engine(backend))
+{
+    if (!this->engine) {
+        throw std::invalid_argument("Batch solving needs a search backend");
+    }
+
+    this->engine->set_limits(&this->limits);
+}
+
+Status
+BatchSolver::solve(
+    const char * in,
+    char * out)
+{
+    SUDOKU_TRACE("BatchSolver::solve");
+
+    grid_t values;
+
+    if (!parse_grid(in, RECORD_LENGTH, values)) {
+        std::memmove(out, in, RECORD_LENGTH);
+        return Status::Invalid;
+    }
+
+    grid_t solution;
+    bool unique;
+    canonical::Key key;
+
+    // One canonical form serves all cache and store calls below.
+    if (this->cache || this->store) {
+        key = canonical::make_key(values);
+    }
+
+    if (this->cache && this->cache->lookup(key, solution, unique)) {
+        format_grid(solution, out);
+        return Status::Solved;
+    }
+
+    SolutionStore::Record record;
+
+    if (this->store && this->store->lookup(key, record)) {
+        if (this->cache) {
+            this->cache->insert(key, record.solution, record.unique);
+        }
+
+        format_grid(record.solution, out);
+        return Status::Solved;
+    }
+
+    this->limits.reset();
+
+    if (this->engine->solve(values, 1) > 0) {
+        if (this->cache) {
+            this->cache->insert(key, this->engine->get_solution(), false);
+        }
+
+        if (this->store && this->store->is_writable()) {
+            record.solution = this->engine->get_solution();
+            record.steps = std::min<size_t>(this->limits.get_steps(), UINT32_MAX);
+            record.backend = this->backend;
+            record.unique = false;
+            this->store->insert(key, record);
+        }
+
+        format_grid(this->engine->get_solution(), out);
+        return Status::Solved;
+    }
+
+    std::memmove(out, in, RECORD_LENGTH);
+
+    if (this->limits.get_status() != Status::Unsolved) {
+        return this->limits.get_status();
+    }
+    return Status::Contradiction;
+}
+
+size_t
+BatchSolver::solve_batch(
+    const char * in,
+    size_t n,
+    char * out,
+    Status * status)
+{
+    size_t solved = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        auto st = solve(in + i * RECORD_LENGTH, out + i * RECORD_LENGTH);
+
+        if (status != nullptr) {
+            status[i] = st;
+        }
+
+        solved += st == Status::Solved;
+    }
+
+    return solved;
+}
+
+size_t
+sudoku::solve_batch(
+    const char * in,
+    size_t n,
+    char * out,
+    Status * status,
+    Backend backend)
+{
+    BatchSolver solver(backend);
+
+    return solver.solve_batch(in, n, out, status);
+}
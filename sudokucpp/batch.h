@@ -0,0 +1,76 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "cache.h"
+#include "engine.h"
+#include "store.h"
+
+namespace sudoku {
+    // Batches are packed records of SUDOKU_GRID_LENGTH characters, in
+    // the format of parse_grid() and format_grid(), without separators.
+    const size_t RECORD_LENGTH = SUDOKU_GRID_LENGTH;
+
+    // Solves batches with one engine, without building a Solver or any
+    // strings per puzzle.  Records that are not solved are copied to the
+    // output as they are.
+    class BatchSolver
+    {
+    public:
+        explicit BatchSolver(Backend backend = Backend::Bitboard);
+
+        // The step budget applies to each puzzle, a deadline or a
+        // cancellation to the rest of the batch.
+        Limits & get_limits() {
+            return this->limits;
+        }
+
+        // Solutions are looked up in and added to the cache, which may
+        // be shared with other solvers.
+        void set_cache(std::shared_ptr<SolutionCache> cache) {
+            this->cache = cache;
+        }
+
+        // Solutions are looked up in the store before solving, and the
+        // ones found added to it when it is writable.
+        void set_store(std::shared_ptr<SolutionStore> store) {
+            this->store = store;
+        }
+
+        // Writes the first solution found; uniqueness is not checked.
+        Status solve(const char * in, char * out);
+
+        // n records from in to out, which may be the same buffer.  The
+        // status of each record goes to status unless it is nullptr.
+        // Returns the number of solved records.
+        size_t solve_batch(const char * in, size_t n, char * out, Status * status);
+
+    private:
+        Backend backend;
+        std::shared_ptr<engine::Engine> engine;
+        std::shared_ptr<SolutionCache> cache;
+        std::shared_ptr<SolutionStore> store;
+        Limits limits;
+    };
+
+    // Convenience for a single batch.
+    size_t solve_batch(const char * in, size_t n, char * out, Status * status,
+                       Backend backend = Backend::Bitboard);
+}
+
+#endif
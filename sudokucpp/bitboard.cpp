@@ -0,0 +1,661 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "config.h"
+#include "bitboard.h"
+
+#if HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace sudoku;
+using namespace sudoku::bitboard;
+
+namespace {
+    const index_t BAND_CELLS = SUDOKU_GRID_LENGTH / SUDOKU_BOXES;
+    const uint32_t BAND_MASK = (1u << BAND_CELLS) - 1;
+    const uint32_t ROW_MASK = (1u << SUDOKU_NUMBERS) - 1;
+    const uint32_t ALL_NUMBERS = (1u << SUDOKU_NUMBERS) - 1;
+
+    // The first cell of each triad, the three cells that a row has in a
+    // box, and the triads of the first box.  In a column mask the same
+    // bits are the first columns of the stacks.
+    const uint32_t TRIADS = 0x1249249;
+    const uint32_t BOX0 = 0x40201;
+    const uint32_t BOX1 = BOX0 << 3;
+    const uint32_t BOX2 = BOX0 << 6;
+
+#if HAVE_SSE2
+    // The words of one number in the three bands and the zero padding.
+    struct Bands {
+        __m128i v;
+    };
+
+    inline Bands
+    operator&(Bands a, Bands b)
+    {
+        return { _mm_and_si128(a.v, b.v) };
+    }
+
+    inline Bands
+    operator|(Bands a, Bands b)
+    {
+        return { _mm_or_si128(a.v, b.v) };
+    }
+
+    inline Bands
+    operator^(Bands a, Bands b)
+    {
+        return { _mm_xor_si128(a.v, b.v) };
+    }
+
+    // a & ~b
+    inline Bands
+    clear(Bands a, Bands b)
+    {
+        return { _mm_andnot_si128(b.v, a.v) };
+    }
+
+    template <int n>
+    inline Bands
+    shl(Bands a)
+    {
+        return { _mm_slli_epi32(a.v, n) };
+    }
+
+    template <int n>
+    inline Bands
+    shr(Bands a)
+    {
+        return { _mm_srli_epi32(a.v, n) };
+    }
+
+    // Band b from band b + 1, and from band b + 2.
+    inline Bands
+    next(Bands a)
+    {
+        return { _mm_shuffle_epi32(a.v, _MM_SHUFFLE(3, 0, 2, 1)) };
+    }
+
+    inline Bands
+    prev(Bands a)
+    {
+        return { _mm_shuffle_epi32(a.v, _MM_SHUFFLE(3, 1, 0, 2)) };
+    }
+
+    inline Bands
+    zero()
+    {
+        return { _mm_setzero_si128() };
+    }
+
+    inline Bands
+    splat(uint32_t x)
+    {
+        return { _mm_set_epi32(0, x, x, x) };
+    }
+
+    // All ones in the words that are zero, the padding included.
+    inline Bands
+    zeros(Bands a)
+    {
+        return { _mm_cmpeq_epi32(a.v, _mm_setzero_si128()) };
+    }
+
+    // Whether any of the three bands is not zero.
+    inline bool
+    any(Bands a)
+    {
+        return (_mm_movemask_epi8(_mm_cmpeq_epi32(a.v, _mm_setzero_si128())) & 0xfff) != 0xfff;
+    }
+
+    inline Bands
+    get(const uint32_t * p)
+    {
+        return { _mm_load_si128(reinterpret_cast<const __m128i *>(p)) };
+    }
+
+    inline void
+    put(uint32_t * p, Bands a)
+    {
+        _mm_store_si128(reinterpret_cast<__m128i *>(p), a.v);
+    }
+#else
+    struct Bands {
+        uint32_t v[SUDOKU_BOXES + 1];
+    };
+
+    inline Bands
+    operator&(Bands a, Bands b)
+    {
+        return { { a.v[0] & b.v[0], a.v[1] & b.v[1], a.v[2] & b.v[2], a.v[3] & b.v[3] } };
+    }
+
+    inline Bands
+    operator|(Bands a, Bands b)
+    {
+        return { { a.v[0] | b.v[0], a.v[1] | b.v[1], a.v[2] | b.v[2], a.v[3] | b.v[3] } };
+    }
+
+    inline Bands
+    operator^(Bands a, Bands b)
+    {
+        return { { a.v[0] ^ b.v[0], a.v[1] ^ b.v[1], a.v[2] ^ b.v[2], a.v[3] ^ b.v[3] } };
+    }
+
+    inline Bands
+    clear(Bands a, Bands b)
+    {
+        return { { a.v[0] & ~b.v[0], a.v[1] & ~b.v[1], a.v[2] & ~b.v[2], a.v[3] & ~b.v[3] } };
+    }
+
+    template <int n>
+    inline Bands
+    shl(Bands a)
+    {
+        return { { a.v[0] << n, a.v[1] << n, a.v[2] << n, a.v[3] << n } };
+    }
+
+    template <int n>
+    inline Bands
+    shr(Bands a)
+    {
+        return { { a.v[0] >> n, a.v[1] >> n, a.v[2] >> n, a.v[3] >> n } };
+    }
+
+    inline Bands
+    next(Bands a)
+    {
+        return { { a.v[1], a.v[2], a.v[0], a.v[3] } };
+    }
+
+    inline Bands
+    prev(Bands a)
+    {
+        return { { a.v[2], a.v[0], a.v[1], a.v[3] } };
+    }
+
+    inline Bands
+    zero()
+    {
+        return { { 0, 0, 0, 0 } };
+    }
+
+    inline Bands
+    splat(uint32_t x)
+    {
+        return { { x, x, x, 0 } };
+    }
+
+    inline Bands
+    zeros(Bands a)
+    {
+        return { {
+            a.v[0] == 0 ? ~0u : 0, a.v[1] == 0 ? ~0u : 0,
+            a.v[2] == 0 ? ~0u : 0, a.v[3] == 0 ? ~0u : 0
+        } };
+    }
+
+    inline bool
+    any(Bands a)
+    {
+        return (a.v[0] | a.v[1] | a.v[2]) != 0;
+    }
+
+    inline Bands
+    get(const uint32_t * p)
+    {
+        return { { p[0], p[1], p[2], p[3] } };
+    }
+
+    inline void
+    put(uint32_t * p, Bands a)
+    {
+        for (index_t i = 0; i <= SUDOKU_BOXES; i++) {
+            p[i] = a.v[i];
+        }
+    }
+#endif
+
+    // Both bands other than b in band b.
+    inline Bands
+    others(Bands a)
+    {
+        return next(a) | prev(a);
+    }
+
+    // The nonempty triads of a word, or stacks of a column mask.
+    inline Bands
+    triads(Bands a)
+    {
+        return (a | shr<1>(a) | shr<2>(a)) & splat(TRIADS);
+    }
+
+    // Triads back to their cells.
+    inline Bands
+    spread(Bands t)
+    {
+        return t | shl<1>(t) | shl<2>(t);
+    }
+
+    // Each cell of a triad from the next cell of it, and from the one
+    // after that.
+    inline Bands
+    spin1(Bands a)
+    {
+        return (shr<1>(a) & splat(TRIADS | (TRIADS << 1))) | (shl<2>(a) & splat(TRIADS << 2));
+    }
+
+    inline Bands
+    spin2(Bands a)
+    {
+        return (shr<2>(a) & splat(TRIADS)) | (shl<1>(a) & splat((TRIADS << 1) | (TRIADS << 2)));
+    }
+
+    // Each row of a band from the next row, and from the one after that.
+    inline Bands
+    row1(Bands a)
+    {
+        return (shr<SUDOKU_NUMBERS>(a) | shl<2 * SUDOKU_NUMBERS>(a)) & splat(BAND_MASK);
+    }
+
+    inline Bands
+    row2(Bands a)
+    {
+        return (shr<2 * SUDOKU_NUMBERS>(a) | shl<SUDOKU_NUMBERS>(a)) & splat(BAND_MASK);
+    }
+
+    // Each triad from the triad of the next box in its row, and from the
+    // box after that.
+    inline Bands
+    box1(Bands t)
+    {
+        return (shr<3>(t) & splat(BOX0 | BOX1)) | (shl<6>(t) & splat(BOX2));
+    }
+
+    inline Bands
+    box2(Bands t)
+    {
+        return (shr<6>(t) & splat(BOX0)) | (shl<3>(t) & splat(BOX1 | BOX2));
+    }
+
+    // A column mask repeated on the three rows of a band.
+    inline Bands
+    rows(Bands columns)
+    {
+        return columns | shl<SUDOKU_NUMBERS>(columns) | shl<2 * SUDOKU_NUMBERS>(columns);
+    }
+
+    inline Bands
+    columns(Bands a)
+    {
+        return (a | shr<SUDOKU_NUMBERS>(a) | shr<2 * SUDOKU_NUMBERS>(a)) & splat(ROW_MASK);
+    }
+
+    // The rows, boxes and columns of some cells, the cells included.
+    inline Bands
+    peers(Bands cells)
+    {
+        Bands t = triads(cells);
+
+        return spread(t | box1(t) | box2(t) | row1(t) | row2(t)) | rows(others(columns(cells)));
+    }
+
+    inline bool
+    solved(const uint32_t * unsolved)
+    {
+        return (unsolved[0] | unsolved[1] | unsolved[2]) == 0;
+    }
+}
+
+BandEngine::BandEngine() : guesses(0)
+{
+    this->solution.fill(0);
+}
+
+size_t
+BandEngine::solve(
+    const grid_t & values,
+    size_t limit)
+{
+    SUDOKU_TRACE("BandEngine::solve");
+
+    size_t count = 0;
+    Frame & root = this->stack[0];
+
+    this->guesses = 0;
+
+    if (!load(root.state, values) || !propagate(root.state)) {
+        return 0;
+    }
+
+    if (solved(root.state.unsolved)) {
+        record(root.state);
+        return 1;
+    }
+
+    root.cell = choose(root.state);
+    root.untried = cell_candidates(root.state, root.cell);
+
+    ssize_t depth = 0;
+
+    while (depth >= 0) {
+        Frame & f = this->stack[depth];
+
+        if (f.untried == 0) {
+            depth--;
+            continue;
+        }
+
+        if (interrupted()) {
+            break;
+        }
+
+        mask_t bit = f.untried & -f.untried;
+        f.untried ^= bit;
+        this->guesses++;
+
+        Frame & next = this->stack[depth + 1];
+        next.state = f.state;
+
+        if (!place(next.state, f.cell, mask_number(bit)) || !propagate(next.state)) {
+            continue;
+        }
+
+        if (solved(next.state.unsolved)) {
+            if (count == 0) {
+                record(next.state);
+            }
+
+            count++;
+
+            if (count >= limit) {
+                break;
+            }
+            continue;
+        }
+
+        next.cell = choose(next.state);
+        next.untried = cell_candidates(next.state, next.cell);
+        depth++;
+    }
+
+    return count;
+}
+
+bool
+BandEngine::load(
+    State & s,
+    const grid_t & values) const
+{
+    alignas(16) Words givens = {};
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        if (values[i] > SUDOKU_NUMBERS) {
+            return false;
+        }
+
+        if (values[i] != 0) {
+            givens[values[i] - 1][i / BAND_CELLS] |= 1u << (i % BAND_CELLS);
+        }
+    }
+
+    Bands filled = zero();
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        filled = filled | get(givens[n]);
+    }
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        put(s.bands[n], clear(splat(BAND_MASK), filled) | get(givens[n]));
+    }
+
+    put(s.unsolved, splat(BAND_MASK));
+    s.changed = ALL_NUMBERS;
+
+    return true;
+}
+
+// Takes the cell from the words of the other numbers and the number
+// from the peers of the cell.
+bool
+BandEngine::place(
+    State & s,
+    index_t cell,
+    index_t number) const
+{
+    alignas(16) uint32_t bits[SUDOKU_BOXES + 1] = { 0 };
+
+    bits[cell / BAND_CELLS] = 1u << (cell % BAND_CELLS);
+
+    Bands x = get(bits);
+    Bands own = get(s.bands[number - 1]);
+
+    if (!any(own & x)) {
+        return false;
+    }
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        Bands a = get(s.bands[n]);
+        Bands b = n == number - 1 ? clear(a, peers(x)) | x : clear(a, x);
+
+        s.changed |= uint32_t(any(a ^ b)) << n;
+        put(s.bands[n], b);
+    }
+
+    return true;
+}
+
+bool
+BandEngine::propagate(
+    State & s) const
+{
+    alignas(16) Words hidden;
+
+    while (s.changed != 0) {
+        if (!reduce(s, hidden) || !naked_singles(s, hidden)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Reduces the words of each changed number, all bands at once, to the
+// cells of the assignments of their rows to boxes, which gives hidden
+// singles and locked candidates within a band.  Columns left alone in a
+// box are taken from the other bands.  A column without the number
+// fails, and cells that are the only ones of their column go to hidden.
+bool
+BandEngine::reduce(
+    State & s,
+    Words & hidden) const
+{
+    Bands bad = zero();
+    uint32_t todo = s.changed;
+
+    s.changed = 0;
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        put(hidden[n], zero());
+    }
+
+    for (; todo != 0; todo &= todo - 1) {
+        index_t n = __builtin_ctz(todo);
+        Bands old = get(s.bands[n]);
+        Bands t = triads(old);
+        Bands t1 = row1(t);
+        Bands t2 = row2(t);
+        Bands a = old & spread(t & ((box1(t1) & box2(t2)) | (box2(t1) & box1(t2))));
+        Bands c = columns(a);
+        Bands o = others(c);
+
+        bad = bad | ((c | o) ^ splat(ROW_MASK));
+        a = clear(a, rows(others(clear(clear(c, spin1(c)), spin2(c)))));
+
+        Bands r0 = a & splat(ROW_MASK);
+        Bands r1 = shr<SUDOKU_NUMBERS>(a) & splat(ROW_MASK);
+        Bands r2 = shr<2 * SUDOKU_NUMBERS>(a);
+        Bands twice = (r0 & r1) | ((r0 | r1) & r2);
+
+        put(hidden[n], a & rows(clear(clear(c, twice), o)));
+        put(s.bands[n], a);
+        bad = bad | zeros(a);
+        s.changed |= uint32_t(any(a ^ old)) << n;
+    }
+
+    return !any(bad);
+}
+
+// Takes the hidden singles from the other numbers, and then the number
+// of each cell that has one candidate left from its row, box and column.
+// Only the cells that were unsolved on the last pass are new singles;
+// two of them with the same number in one house fail.
+bool
+BandEngine::naked_singles(
+    State & s,
+    const Words & hidden) const
+{
+    Bands found = zero();
+    Bands bad = zero();
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        Bands h = get(hidden[n]);
+
+        bad = bad | (found & h);
+        found = found | h;
+    }
+
+    Bands words[SUDOKU_NUMBERS];
+    Bands once = zero();
+    Bands twice = zero();
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        Bands x = clear(get(s.bands[n]), clear(found, get(hidden[n])));
+
+        twice = twice | (once & x);
+        once = once | x;
+        words[n] = x;
+    }
+
+    bad = bad | (once ^ splat(BAND_MASK));
+
+    Bands fresh = get(s.unsolved);
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        Bands single = clear(words[n], twice) & fresh;
+        Bands x = words[n];
+
+        if (any(single)) {
+            Bands t = triads(single);
+            Bands c = columns(single);
+
+            bad = bad | (single & spin1(single)) | (t & box1(t)) | (t & row1(t)) | (c & next(c));
+            x = clear(x, peers(single)) | single;
+        }
+
+        s.changed |= uint32_t(any(x ^ get(s.bands[n]))) << n;
+        put(s.bands[n], x);
+    }
+
+    put(s.unsolved, twice);
+
+    return !any(bad);
+}
+
+// A cell with two candidates in the band with the most unsolved cells,
+// where a guess settles the most, or else a cell with the fewest.
+index_t
+BandEngine::choose(
+    const State & s) const
+{
+    Bands once = zero();
+    Bands twice = zero();
+    Bands thrice = zero();
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        Bands x = get(s.bands[n]);
+
+        thrice = thrice | (twice & x);
+        twice = twice | (once & x);
+        once = once | x;
+    }
+
+    alignas(16) uint32_t pairs[SUDOKU_BOXES + 1];
+    alignas(16) uint32_t open[SUDOKU_BOXES + 1];
+    index_t band = SUDOKU_BOXES;
+    int most = 0;
+
+    put(pairs, clear(twice, thrice));
+    put(open, twice);
+
+    for (index_t b = 0; b < SUDOKU_BOXES; b++) {
+        if (pairs[b] != 0 && __builtin_popcount(open[b]) > most) {
+            band = b;
+            most = __builtin_popcount(open[b]);
+        }
+    }
+
+    if (band < SUDOKU_BOXES) {
+        return band * BAND_CELLS + __builtin_ctz(pairs[band]);
+    }
+
+    index_t best = 0;
+    index_t best_count = SUDOKU_NUMBERS + 1;
+
+    for (band = 0; band < SUDOKU_BOXES; band++) {
+        for (uint32_t bits = open[band]; bits != 0; bits &= bits - 1) {
+            index_t i = band * BAND_CELLS + __builtin_ctz(bits);
+            auto n = mask_count(cell_candidates(s, i));
+
+            if (n < best_count) {
+                best = i;
+                best_count = n;
+            }
+        }
+    }
+
+    return best;
+}
+
+mask_t
+BandEngine::cell_candidates(
+    const State & s,
+    index_t cell) const
+{
+    index_t band = cell / BAND_CELLS;
+    index_t bit = cell % BAND_CELLS;
+    mask_t m = 0;
+
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        m |= ((s.bands[n][band] >> bit) & 1) << n;
+    }
+
+    return m;
+}
+
+void
+BandEngine::record(
+    const State & s)
+{
+    for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+        for (index_t band = 0; band < SUDOKU_BOXES; band++) {
+            for (uint32_t bits = s.bands[n][band]; bits != 0; bits &= bits - 1) {
+                this->solution[band * BAND_CELLS + __builtin_ctz(bits)] = n + 1;
+            }
+        }
+    }
+}
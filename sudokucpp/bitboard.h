@@ -0,0 +1,91 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include "engine.h"
+
+namespace sudoku {
+    namespace bitboard {
+        // Brute-force engine in the style of the fast band-oriented
+        // solvers.  Every number has a 27-bit word per band of the cells
+        // where it is still possible, rows of 9 bits one after another,
+        // and the three words of a number are kept together so that they
+        // are handled as one 128-bit vector.  Propagation works on all
+        // bands of a number at once with shifts and masks: rows are
+        // matched to boxes for hidden singles and locked candidates,
+        // columns are passed between the bands, and naked singles are
+        // found for all cells by bit-slicing the nine numbers.  The
+        // search guesses on a cell with two candidates in the band with
+        // the most unsolved cells.
+        //
+        // The vectors are SSE2 when configure finds it, and plain words
+        // otherwise or with --disable-simd.  This bypasses Solver and the
+        // eliminator framework entirely.
+        class BandEngine : public engine::Engine
+        {
+        public:
+            BandEngine();
+
+            virtual size_t solve(const grid_t & values, size_t limit = 2);
+
+            virtual const grid_t & get_solution() const {
+                return this->solution;
+            }
+
+            size_t get_guesses() const {
+                return this->guesses;
+            }
+
+        private:
+            // Number n, band b at [n][b]; the fourth word is padding and
+            // stays zero.
+            typedef uint32_t Words[SUDOKU_NUMBERS][SUDOKU_BOXES + 1];
+
+            struct State {
+                alignas(16) Words bands;
+                // Cells with more than one candidate as of the last pass
+                // of naked singles, a word per band.
+                alignas(16) uint32_t unsolved[SUDOKU_BOXES + 1];
+                // A bit per number whose words changed since its rules
+                // were last applied.
+                uint32_t changed;
+            };
+
+            struct Frame {
+                State state;
+                index_t cell;
+                mask_t untried;
+            };
+
+            bool load(State & s, const grid_t & values) const;
+            bool place(State & s, index_t cell, index_t number) const;
+            bool propagate(State & s) const;
+            bool reduce(State & s, Words & hidden) const;
+            bool naked_singles(State & s, const Words & hidden) const;
+            index_t choose(const State & s) const;
+            mask_t cell_candidates(const State & s, index_t cell) const;
+            void record(const State & s);
+
+            Frame stack[SUDOKU_GRID_LENGTH + 1];
+            grid_t solution;
+            size_t guesses;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,111 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "config.h"
+#include "cache.h"
+
+using namespace sudoku;
+
+SolutionCache::SolutionCache(
+    size_t capacity,
+    size_t shards) : hits(0), misses(0)
+{
+    if (shards == 0) {
+        throw std::invalid_argument("A cache needs at least one shard");
+    }
+
+    for (size_t i = 0; i < shards; i++) {
+        this->shards.emplace_back(new Shard());
+    }
+
+    this->shard_capacity = std::max<size_t>(1, capacity / shards);
+}
+
+bool
+SolutionCache::lookup(
+    const canonical::Key & key,
+    grid_t & solution,
+    bool & unique)
+{
+    SUDOKU_TRACE("SolutionCache::lookup");
+
+    auto & shard = get_shard(key.hash);
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key.hash);
+
+        if (it != shard.index.end() && it->second->puzzle == key.grid) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            solution = key.transform.revert(it->second->solution);
+            unique = it->second->unique;
+
+            this->hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    this->misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void
+SolutionCache::insert(
+    const canonical::Key & key,
+    const grid_t & solution,
+    bool unique)
+{
+    auto & shard = get_shard(key.hash);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key.hash);
+
+    if (it != shard.index.end()) {
+        auto & entry = *it->second;
+
+        // A different puzzle with the same hash is replaced.
+        if (entry.puzzle != key.grid || !entry.unique || unique) {
+            entry.puzzle = key.grid;
+            entry.solution = key.transform.apply(solution);
+            entry.unique = unique;
+        }
+
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+
+    shard.entries.push_front(Entry { key.hash, key.grid, key.transform.apply(solution), unique });
+    shard.index[key.hash] = shard.entries.begin();
+
+    if (shard.entries.size() > this->shard_capacity) {
+        shard.index.erase(shard.entries.back().hash);
+        shard.entries.pop_back();
+    }
+}
+
+size_t
+SolutionCache::size() const
+{
+    size_t n = 0;
+
+    for (auto & shard: this->shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+
+        n += shard->entries.size();
+    }
+
+    return n;
+}
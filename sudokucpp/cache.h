@@ -0,0 +1,94 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "canonical.h"
+
+namespace sudoku {
+    // Solutions keyed by the canonical form of their puzzles, so that
+    // any symmetric variant of a solved puzzle is a lookup.
+    // The entries are split over shards by hash, each an LRU list with
+    // its own lock, so that threads seldom wait for each other.
+    class SolutionCache
+    {
+    public:
+        // Holds at most about capacity entries.
+        explicit SolutionCache(size_t capacity, size_t shards = 16);
+
+        SolutionCache(const SolutionCache &) = delete;
+        SolutionCache & operator=(const SolutionCache &) = delete;
+
+        // Finds the solution of puzzle, in the frame of puzzle.  unique
+        // tells whether the solution was known to be the only one.
+        bool lookup(const grid_t & puzzle, grid_t & solution, bool & unique) {
+            return lookup(canonical::make_key(puzzle), solution, unique);
+        }
+
+        // With the key of the puzzle, for callers that also use it with
+        // a SolutionStore.
+        bool lookup(const canonical::Key & key, grid_t & solution, bool & unique);
+
+        // An entry known to be unique is not replaced by one that is not.
+        void insert(const grid_t & puzzle, const grid_t & solution, bool unique) {
+            insert(canonical::make_key(puzzle), solution, unique);
+        }
+
+        void insert(const canonical::Key & key, const grid_t & solution, bool unique);
+
+        size_t size() const;
+
+        size_t get_hits() const {
+            return this->hits.load(std::memory_order_relaxed);
+        }
+
+        size_t get_misses() const {
+            return this->misses.load(std::memory_order_relaxed);
+        }
+
+    private:
+        // Puzzle and solution in canonical form.
+        struct Entry {
+            uint64_t hash;
+            grid_t puzzle;
+            grid_t solution;
+            bool unique;
+        };
+
+        struct Shard {
+            mutable std::mutex mutex;
+            // Most recently used first.
+            std::list<Entry> entries;
+            std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        };
+
+        Shard & get_shard(uint64_t hash) {
+            return *this->shards[(hash >> 32) % this->shards.size()];
+        }
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        size_t shard_capacity;
+        std::atomic<size_t> hits;
+        std::atomic<size_t> misses;
+    };
+}
+
+#endif
@@ -0,0 +1,821 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+#include "config.h"
+#include "canonical.h"
+#include "permutations.h"
+
+using namespace sudoku;
+using namespace sudoku::canonical;
+
+namespace {
+    typedef std::array<index_t, SUDOKU_NUMBERS> line_t;
+
+    // Greater than any cell value, for a row not seen yet.
+    const index_t UNSEEN = 0xff;
+
+    // Marks the label of a digit of the first row that depends on the
+    // order of tied columns, with the column of the digit in the low
+    // bits.
+    const index_t DEFERRED = 0x80;
+
+    // States kept allocated between calls; symmetric grids can need
+    // many more.
+    const size_t RETAIN = 1 << 15;
+
+    // The six orders of the stacks.
+    struct Orders {
+        index_t items[6][SUDOKU_BOXES];
+
+        Orders() {
+            size_t k = 0;
+
+            permutation::for_each(SUDOKU_BOXES, [this, &k](const permutation::FixedPermutation & p) {
+                for (index_t i = 0; i < SUDOKU_BOXES; i++) {
+                    this->items[k][i] = p[i];
+                }
+                k++;
+            });
+        }
+    };
+
+    const Orders orders;
+
+    // A partial transform whose rows so far give the smallest prefix.
+    // Columns that look the same in all those rows can still be swapped
+    // with the ones next to them in the same stack: bit p of tied joins
+    // position p with position p + 1.  Their order is only decided by
+    // the first row that tells them apart.
+    //
+    // That includes the givens of a first row without repeated digits:
+    // they are labelled in position order whatever the order, so the
+    // labels of their digits are deferred until a later row has them.
+    // For the same reason stacks with as many givens in the first row
+    // are tied as a whole: bit k of stacks joins the stacks at
+    // positions k and k + 1, which have the same ties inside.
+    struct State {
+        bool transpose;
+        index_t next;
+        uint8_t stacks;
+        uint16_t used;
+        uint16_t tied;
+        line_t rows;
+        line_t columns;
+        // The labels of the first row by position.
+        line_t top;
+        std::array<index_t, SUDOKU_NUMBERS + 1> digits;
+
+        index_t label(index_t v) {
+            if (v != 0 && this->digits[v] == 0) {
+                this->digits[v] = this->next++;
+            } else if (this->digits[v] & DEFERRED) {
+                this->digits[v] = settle(this->digits[v] & ~DEFERRED);
+            }
+            return this->digits[v];
+        }
+
+        // Moves the column of a deferred digit to the front of its tied
+        // stacks and columns, where it takes the smallest label they
+        // have left; any other place would make the row being compared
+        // greater.
+        index_t settle(index_t column) {
+            index_t x = find(column);
+            index_t k = x / SUDOKU_BOXES;
+            index_t first = k;
+
+            while (first > 0 && (this->stacks & (1 << (first - 1)))) {
+                first--;
+            }
+
+            if (first != k || (this->stacks & (1 << k))) {
+                pick(first, k);
+                x = find(column);
+            }
+
+            index_t a = x;
+
+            while (a > 0 && (this->tied & (1 << (a - 1)))) {
+                a--;
+            }
+
+            move(a, x);
+            this->tied &= ~(1 << a);
+
+            return this->top[a];
+        }
+
+        // Moves the column at position x to position a before it; the
+        // ones in between keep their order.
+        void move(index_t a, index_t x) {
+            index_t column = this->columns[x];
+
+            for (; x > a; x--) {
+                this->columns[x] = this->columns[x - 1];
+            }
+            this->columns[a] = column;
+        }
+
+        index_t find(index_t column) const {
+            index_t x = 0;
+
+            while (this->columns[x] != column) {
+                x++;
+            }
+            return x;
+        }
+
+        // Moves the stack at position k to position first, the front of
+        // the tied stacks, and unties it from the others.  Those stay in
+        // ascending order.
+        void pick(index_t first, index_t k) {
+            for (index_t i = 0; i < SUDOKU_BOXES; i++) {
+                move(first * SUDOKU_BOXES + i, k * SUDOKU_BOXES + i);
+            }
+            this->stacks &= ~(1 << first);
+        }
+
+        // What the remaining rows depend on; the order of the rows so
+        // far does not matter.
+        bool operator<(const State & other) const {
+            return std::tie(this->transpose, this->used, this->stacks, this->tied, this->columns, this->digits)
+                < std::tie(other.transpose, other.used, other.stacks, other.tied, other.columns, other.digits);
+        }
+
+        bool operator==(const State & other) const {
+            return this->transpose == other.transpose && this->used == other.used
+                && this->stacks == other.stacks && this->tied == other.tied
+                && this->columns == other.columns
+                && this->digits == other.digits;
+        }
+    };
+
+    // Compares values with cells [first, first + n) of the best row so
+    // far.  A smaller row becomes the best one, and the states kept for
+    // the old one are dropped.  Returns false when the row is greater.
+    bool
+    keep(
+        const index_t * values,
+        line_t & best,
+        size_t first,
+        size_t n,
+        std::vector<State> & states)
+    {
+        int cmp = std::memcmp(values, &best[first], n);
+
+        if (cmp > 0) {
+            return false;
+        }
+
+        if (cmp < 0) {
+            std::memcpy(&best[first], values, n);
+            std::fill(best.begin() + first + n, best.end(), UNSEEN);
+            states.clear();
+        }
+
+        return true;
+    }
+
+    void
+    arrange(
+        State state,
+        const index_t * row,
+        index_t q,
+        index_t end,
+        index_t * values,
+        line_t & best,
+        std::vector<State> & states);
+
+    // Orders the tied columns from position p on so that row is the
+    // smallest, a group of tied columns at a time, so that a group that
+    // makes the prefix greater cuts off the orders of the groups after
+    // it.  Each of the tied stacks is tried first at its position.
+    // Unsolved cells go first and stay tied; arrange() orders the
+    // givens, since their labels depend on the order.
+    void
+    place(
+        const State & state,
+        const index_t * row,
+        index_t p,
+        index_t * values,
+        line_t & best,
+        std::vector<State> & states)
+    {
+        index_t k = p / SUDOKU_BOXES;
+
+        if (state.stacks & (1 << k)) {
+            index_t last = k + 1;
+
+            while (state.stacks & (1 << last)) {
+                last++;
+            }
+
+            // Tied stacks without givens in row stay tied.
+            index_t stop = (last + 1) * SUDOKU_BOXES;
+            index_t q = p;
+
+            while (q < stop && row[state.columns[q]] == 0) {
+                q++;
+            }
+
+            if (q == stop) {
+                std::fill(values + p, values + stop, 0);
+
+                if (keep(values + p, best, p, stop - p, states)) {
+                    place(state, row, stop, values, best, states);
+                }
+                return;
+            }
+
+            for (index_t j = k; j <= last; j++) {
+                State s = state;
+
+                s.pick(k, j);
+                place(s, row, p, values, best, states);
+            }
+            return;
+        }
+
+        // No ties left: the columns are fixed, so the rest of the row
+        // is labelled and compared in one pass.  Tied stacks have tied
+        // columns, so settling a deferred label moves none after p.
+        if ((state.tied >> p) == 0) {
+            State s = state;
+            bool smaller = false;
+
+            for (index_t q = p; q < SUDOKU_NUMBERS; q++) {
+                values[q] = s.label(row[s.columns[q]]);
+
+                if (!smaller) {
+                    if (values[q] > best[q]) {
+                        return;
+                    }
+                    smaller = values[q] < best[q];
+                }
+            }
+
+            if (smaller) {
+                std::memcpy(&best[p], values + p, SUDOKU_NUMBERS - p);
+                states.clear();
+            }
+
+            states.push_back(s);
+            return;
+        }
+
+        index_t end = p + 1;
+
+        while (end < SUDOKU_NUMBERS && (state.tied & (1 << (end - 1)))) {
+            end++;
+        }
+
+        // Tied columns are kept in ascending order, so that states that
+        // only differ by them compare equal.
+        State s = state;
+        index_t z = 0;
+        index_t q = p;
+
+        for (bool given: { false, true }) {
+            for (index_t i = p; i < end; i++) {
+                index_t column = state.columns[i];
+
+                if ((row[column] != 0) == given) {
+                    s.columns[q++] = column;
+                    z += !given;
+                }
+            }
+        }
+
+        // The unsolved cells and the givens as two tied groups.
+        s.tied &= ~(((1 << (end - p)) - 1) << p);
+
+        if (z > 1) {
+            s.tied |= ((1 << (z - 1)) - 1) << p;
+        }
+        if (end - p - z > 1) {
+            s.tied |= ((1 << (end - p - z - 1)) - 1) << (p + z);
+        }
+
+        std::fill(values + p, values + p + z, 0);
+
+        if (z == 0 || keep(values + p, best, p, z, states)) {
+            arrange(s, row, p + z, end, values, best, states);
+        }
+    }
+
+    // Orders the tied givens of row at positions [q, end) one position
+    // at a time: each is tried first, and only those with the smallest
+    // label go on.  The rest stay tied meanwhile, so a deferred label
+    // settled into them takes the next position.
+    void
+    arrange(
+        State state,
+        const index_t * row,
+        index_t q,
+        index_t end,
+        index_t * values,
+        line_t & best,
+        std::vector<State> & states)
+    {
+        while (q < end && (state.tied & (1 << q)) == 0) {
+            values[q] = state.label(row[state.columns[q]]);
+
+            if (!keep(values + q, best, q, 1, states)) {
+                return;
+            }
+            q++;
+        }
+
+        if (q == end) {
+            place(state, row, end, values, best, states);
+            return;
+        }
+
+        index_t n = 1;
+
+        while (state.tied & (1 << (q + n - 1))) {
+            n++;
+        }
+
+        State tries[SUDOKU_BOXES];
+        index_t labels[SUDOKU_BOXES];
+        index_t low = UNSEEN;
+
+        for (index_t i = 0; i < n; i++) {
+            State & s = tries[i];
+
+            s = state;
+            s.move(q, q + i);
+            s.tied &= ~(1 << q);
+            labels[i] = s.label(row[s.columns[q]]);
+            low = std::min(low, labels[i]);
+        }
+
+        values[q] = low;
+
+        if (!keep(values + q, best, q, 1, states)) {
+            return;
+        }
+
+        for (index_t i = 0; i < n; i++) {
+            if (labels[i] == low) {
+                arrange(tries[i], row, q + 1, end, values, best, states);
+            }
+        }
+    }
+
+    // The first row that row can give when its digits are distinct:
+    // the stacks by ascending number of givens, each with its unsolved
+    // cells first, as a bit per given.  Sets bit 9 when a digit
+    // repeats, since labels then do not follow from the givens alone.
+    unsigned
+    first_row_pattern(
+        const index_t * row)
+    {
+        index_t counts[SUDOKU_BOXES] = {};
+        mask_t seen = 0;
+        unsigned repeats = 0;
+
+        // Without branches, since the givens of a puzzle are too
+        // irregular to predict; bit 0 stands for the unsolved cells.
+        for (index_t c = 0; c < SUDOKU_NUMBERS; c++) {
+            mask_t bit = (1 << row[c]) & ~1;
+
+            counts[c / SUDOKU_BOXES] += row[c] != 0;
+            repeats |= seen & bit;
+            seen |= bit;
+        }
+
+        if (counts[0] > counts[1]) {
+            std::swap(counts[0], counts[1]);
+        }
+        if (counts[1] > counts[2]) {
+            std::swap(counts[1], counts[2]);
+        }
+        if (counts[0] > counts[1]) {
+            std::swap(counts[0], counts[1]);
+        }
+
+        unsigned pattern = 0;
+
+        for (auto n: counts) {
+            pattern = (pattern << SUDOKU_BOXES) | ((1 << n) - 1);
+        }
+
+        return repeats != 0 ? pattern | (1 << SUDOKU_NUMBERS) : pattern;
+    }
+
+    // Symmetric grids leave many states that differ only by the order
+    // of the rows so far.
+    void
+    deduplicate(
+        std::vector<State> & states)
+    {
+        if (states.size() > 1) {
+            std::sort(states.begin(), states.end());
+            states.erase(std::unique(states.begin(), states.end()), states.end());
+        }
+    }
+
+    // The most leading zeros that row can have in the stack at position
+    // k with the columns of state: unsolved cells go first in each tied
+    // group.
+    index_t
+    most_zeros(
+        const State & state,
+        const index_t * row,
+        index_t k)
+    {
+        index_t p = k * SUDOKU_BOXES;
+        index_t stop = p + SUDOKU_BOXES;
+
+        while (p < stop) {
+            index_t end = p + 1;
+
+            while (end < stop && (state.tied & (1 << (end - 1)))) {
+                end++;
+            }
+
+            index_t z = 0;
+
+            for (index_t q = p; q < end; q++) {
+                z += row[state.columns[q]] == 0;
+            }
+
+            if (z != end - p) {
+                return p + z - k * SUDOKU_BOXES;
+            }
+
+            p = end;
+        }
+
+        return SUDOKU_BOXES;
+    }
+
+    // The most leading zeros that row can have with the columns of
+    // state, when the tied stacks without givens go first and the one
+    // with the most leading zeros next.  Rows with fewer can not give
+    // the smallest row.
+    index_t
+    most_zeros(
+        const State & state,
+        const index_t * row)
+    {
+        index_t k = 0;
+
+        while (k < SUDOKU_BOXES) {
+            index_t last = k;
+
+            while (state.stacks & (1 << last)) {
+                last++;
+            }
+
+            index_t blank = 0;
+            index_t most = 0;
+
+            for (index_t j = k; j <= last; j++) {
+                index_t z = most_zeros(state, row, j);
+
+                if (z == SUDOKU_BOXES) {
+                    blank++;
+                } else {
+                    most = std::max(most, z);
+                }
+            }
+
+            if (blank <= last - k) {
+                return (k + blank) * SUDOKU_BOXES + most;
+            }
+
+            k = last + 1;
+        }
+
+        return SUDOKU_NUMBERS;
+    }
+
+    // Rows that may come next: the rest of the band of the last row,
+    // or any row of an unused band after a complete band.
+    uint16_t
+    next_rows(
+        const State & state,
+        index_t level)
+    {
+        uint16_t rows = 0;
+
+        if (level % SUDOKU_BOXES != 0) {
+            index_t band = state.rows[level - 1] / SUDOKU_BOXES;
+
+            rows = 07 << (band * SUDOKU_BOXES);
+        } else {
+            for (index_t band = 0; band < SUDOKU_BOXES; band++) {
+                uint16_t b = 07 << (band * SUDOKU_BOXES);
+
+                if ((state.used & b) == 0) {
+                    rows |= b;
+                }
+            }
+        }
+
+        return rows & ~state.used;
+    }
+}
+
+Transform::Transform() : transpose(false)
+{
+    for (index_t i = 0; i < SUDOKU_NUMBERS; i++) {
+        this->rows[i] = i;
+        this->columns[i] = i;
+    }
+
+    for (index_t d = 0; d <= SUDOKU_NUMBERS; d++) {
+        this->digits[d] = d;
+    }
+}
+
+grid_t
+Transform::apply(
+    const grid_t & grid) const
+{
+    grid_t result;
+
+    for (index_t r = 0; r < SUDOKU_NUMBERS; r++) {
+        for (index_t c = 0; c < SUDOKU_NUMBERS; c++) {
+            index_t i = this->rows[r];
+            index_t j = this->columns[c];
+            index_t v = this->transpose
+                ? grid[j * SUDOKU_NUMBERS + i] : grid[i * SUDOKU_NUMBERS + j];
+
+            result[r * SUDOKU_NUMBERS + c] = this->digits[v];
+        }
+    }
+
+    return result;
+}
+
+grid_t
+Transform::revert(
+    const grid_t & grid) const
+{
+    std::array<index_t, SUDOKU_NUMBERS + 1> inverse;
+    grid_t result;
+
+    for (index_t d = 0; d <= SUDOKU_NUMBERS; d++) {
+        inverse[this->digits[d]] = d;
+    }
+
+    for (index_t r = 0; r < SUDOKU_NUMBERS; r++) {
+        for (index_t c = 0; c < SUDOKU_NUMBERS; c++) {
+            index_t i = this->rows[r];
+            index_t j = this->columns[c];
+            index_t v = inverse[grid[r * SUDOKU_NUMBERS + c]];
+
+            if (this->transpose) {
+                result[j * SUDOKU_NUMBERS + i] = v;
+            } else {
+                result[i * SUDOKU_NUMBERS + j] = v;
+            }
+        }
+    }
+
+    return result;
+}
+
+grid_t
+sudoku::canonical::canonicalize(
+    const grid_t & grid,
+    Transform & transform)
+{
+    SUDOKU_TRACE("canonical::canonicalize");
+
+    thread_local std::vector<State> states;
+    thread_local std::vector<State> next;
+    // The most_zeros() of each state and next row at a level.
+    thread_local std::vector<index_t> zeros;
+    grid_t grids[2];
+    line_t best;
+    index_t values[SUDOKU_NUMBERS];
+
+    grids[0] = grid;
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        grids[1][i] = grid[(i % SUDOKU_NUMBERS) * SUDOKU_NUMBERS + i / SUDOKU_NUMBERS];
+    }
+
+    states.clear();
+    best.fill(UNSEEN);
+
+    // Only the rows that can give the smallest first row, and those
+    // with repeated digits, can start the grid.
+    unsigned patterns[2][SUDOKU_NUMBERS];
+    unsigned smallest = ~0U;
+
+    for (bool transpose: { false, true }) {
+        for (index_t r = 0; r < SUDOKU_NUMBERS; r++) {
+            auto & p = patterns[transpose][r];
+
+            p = first_row_pattern(&grids[transpose][r * SUDOKU_NUMBERS]);
+            smallest = std::min(smallest, p & ~(1U << SUDOKU_NUMBERS));
+        }
+    }
+
+    for (bool transpose: { false, true }) {
+        for (index_t r = 0; r < SUDOKU_NUMBERS; r++) {
+            if (patterns[transpose][r] != smallest
+                && (patterns[transpose][r] & (1 << SUDOKU_NUMBERS)) == 0) {
+                continue;
+            }
+
+            const index_t * row = &grids[transpose][r * SUDOKU_NUMBERS];
+            State state;
+
+            state.transpose = transpose;
+            state.next = 1;
+            state.stacks = 0;
+            state.used = 1 << r;
+            state.tied = 0;
+            state.rows[0] = r;
+            state.top.fill(0);
+            state.digits.fill(0);
+
+            if (patterns[transpose][r] & (1 << SUDOKU_NUMBERS)) {
+                for (auto & stacks: orders.items) {
+                    State s = state;
+
+                    for (index_t i = 0; i < SUDOKU_NUMBERS; i++) {
+                        s.columns[i] = stacks[i / SUDOKU_BOXES] * SUDOKU_BOXES + i % SUDOKU_BOXES;
+
+                        if (i % SUDOKU_BOXES != SUDOKU_BOXES - 1) {
+                            s.tied |= 1 << i;
+                        }
+                    }
+
+                    place(s, row, 0, values, best, states);
+                }
+                continue;
+            }
+
+            // The stacks by ascending number of givens, each with its
+            // unsolved cells and its givens as two tied groups; the
+            // givens are labelled in order.
+            index_t counts[SUDOKU_BOXES] = {};
+            index_t stacks[SUDOKU_BOXES] = { 0, 1, 2 };
+
+            for (index_t c = 0; c < SUDOKU_NUMBERS; c++) {
+                counts[c / SUDOKU_BOXES] += row[c] != 0;
+            }
+
+            // Stable, so that tied stacks are in ascending order.
+            for (index_t k = 1; k < SUDOKU_BOXES; k++) {
+                for (index_t j = k; j > 0 && counts[stacks[j - 1]] > counts[stacks[j]]; j--) {
+                    std::swap(stacks[j - 1], stacks[j]);
+                }
+            }
+
+            for (index_t k = 1; k < SUDOKU_BOXES; k++) {
+                if (counts[stacks[k - 1]] == counts[stacks[k]]) {
+                    state.stacks |= 1 << (k - 1);
+                }
+            }
+
+            index_t q = 0;
+
+            for (index_t k = 0; k < SUDOKU_BOXES; k++) {
+                for (bool given: { false, true }) {
+                    index_t first = q;
+
+                    for (index_t i = 0; i < SUDOKU_BOXES; i++) {
+                        index_t column = stacks[k] * SUDOKU_BOXES + i;
+
+                        if ((row[column] != 0) != given) {
+                            continue;
+                        }
+
+                        if (q != first) {
+                            state.tied |= 1 << (q - 1);
+                        }
+
+                        state.columns[q] = column;
+
+                        if (given) {
+                            state.digits[row[column]] = DEFERRED | column;
+                            values[q++] = state.next++;
+                        } else {
+                            values[q++] = 0;
+                        }
+                    }
+                }
+            }
+
+            if (keep(values, best, 0, SUDOKU_NUMBERS, states)) {
+                std::memcpy(state.top.data(), values, SUDOKU_NUMBERS);
+                states.push_back(state);
+            }
+        }
+    }
+
+    for (index_t level = 1; level < SUDOKU_NUMBERS; level++) {
+        next.clear();
+        best.fill(UNSEEN);
+
+        index_t most = 0;
+
+        zeros.clear();
+
+        for (auto & state: states) {
+            const grid_t & g = grids[state.transpose];
+
+            for (uint16_t rows = next_rows(state, level); rows != 0; rows &= rows - 1) {
+                index_t z = most_zeros(state, &g[__builtin_ctz(rows) * SUDOKU_NUMBERS]);
+
+                zeros.push_back(z);
+                most = std::max(most, z);
+            }
+        }
+
+        auto z = zeros.begin();
+
+        for (auto & state: states) {
+            const grid_t & g = grids[state.transpose];
+
+            for (uint16_t rows = next_rows(state, level); rows != 0; rows &= rows - 1) {
+                index_t r = __builtin_ctz(rows);
+
+                if (*z++ < most) {
+                    continue;
+                }
+
+                State s = state;
+
+                s.rows[level] = r;
+                s.used |= 1 << r;
+
+                place(s, &g[r * SUDOKU_NUMBERS], 0, values, best, next);
+            }
+        }
+
+        deduplicate(next);
+        std::swap(states, next);
+    }
+
+    State & state = states.front();
+
+    // Digits that are not given take the remaining labels.
+    for (index_t d = 1; d <= SUDOKU_NUMBERS; d++) {
+        state.label(d);
+    }
+
+    transform.transpose = state.transpose;
+    transform.rows = state.rows;
+    transform.columns = state.columns;
+    transform.digits = state.digits;
+
+    for (auto v: { &states, &next }) {
+        if (v->capacity() > RETAIN) {
+            std::vector<State>().swap(*v);
+        }
+    }
+
+    return transform.apply(grid);
+}
+
+uint64_t
+sudoku::canonical::hash(
+    const grid_t & grid)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (auto v: grid) {
+        h = (h ^ v) * 1099511628211ULL;
+    }
+
+    return h;
+}
+
+canonical::Key
+sudoku::canonical::make_key(
+    const grid_t & grid)
+{
+    Key key;
+
+    key.grid = canonicalize(grid, key.transform);
+    key.hash = hash(key.grid);
+
+    return key;
+}
@@ -0,0 +1,64 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef CANONICAL_H
+#define CANONICAL_H
+
+#include "sudoku.h"
+
+namespace sudoku {
+    namespace canonical {
+        // A symmetry of sudoku: an optional transposition, then a
+        // permutation of the rows and of the columns and a relabeling of
+        // the digits.  Row r of the result is row rows[r] of the
+        // (transposed) grid, and digit d becomes digits[d]; 0 stays 0.
+        struct Transform {
+            bool transpose;
+            std::array<index_t, SUDOKU_NUMBERS> rows;
+            std::array<index_t, SUDOKU_NUMBERS> columns;
+            std::array<index_t, SUDOKU_NUMBERS + 1> digits;
+
+            Transform();
+
+            grid_t apply(const grid_t & grid) const;
+
+            // The inverse of apply().
+            grid_t revert(const grid_t & grid) const;
+        };
+
+        // The minimum lexicographic grid, with 0 for unsolved cells, that
+        // any transform of grid gives, and a transform that gives it.
+        // Equivalent puzzles have the same form.  The rows are picked
+        // one at a time, keeping only the transforms that give the
+        // smallest rows so far.
+        grid_t canonicalize(const grid_t & grid, Transform & transform);
+
+        // 64-bit FNV-1a of the cell values.
+        uint64_t hash(const grid_t & grid);
+
+        // The canonical form of a puzzle with its hash and transform,
+        // worked out once and handed to SolutionCache and SolutionStore.
+        struct Key {
+            grid_t grid;
+            uint64_t hash;
+            Transform transform;
+        };
+
+        Key make_key(const grid_t & grid);
+    }
+}
+
+#endif
@@ -0,0 +1,641 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "config.h"
+#include "cdcl.h"
+
+using namespace sudoku;
+using namespace sudoku::cdcl;
+
+const size_t CdclEngine::VARIABLES;
+const size_t CdclEngine::LITERALS;
+const size_t CdclEngine::IMPLICATIONS;
+
+namespace {
+    const int32_t NO_REASON = -1;
+    const int32_t NO_CONFLICT = -1;
+    const int32_t BINARY_CONFLICT = -2;
+
+    const size_t RESTART_BASE = 64;
+    const size_t LEARNT_LIMIT = 2000;
+
+    // Reasons below NO_REASON are binary clauses, encoded by their other
+    // (false) literal.
+    inline int32_t
+    binary_reason(uint32_t other)
+    {
+        return -2 - static_cast<int32_t>(other);
+    }
+
+    inline uint32_t
+    binary_other(int32_t reason)
+    {
+        return static_cast<uint32_t>(-2 - reason);
+    }
+
+    inline uint32_t
+    positive(size_t v)
+    {
+        return static_cast<uint32_t>(2 * v);
+    }
+
+    inline uint32_t
+    negative(size_t v)
+    {
+        return static_cast<uint32_t>(2 * v + 1);
+    }
+
+    size_t
+    luby(size_t x)
+    {
+        size_t size = 1;
+        size_t seq = 0;
+
+        while (size < x + 1) {
+            seq++;
+            size = 2 * size + 1;
+        }
+
+        while (size - 1 != x) {
+            size = (size - 1) >> 1;
+            seq--;
+            x = x % size;
+        }
+
+        return static_cast<size_t>(1) << seq;
+    }
+}
+
+CdclEngine::CdclEngine() : conflicts(0), decisions(0)
+{
+    this->solution.fill(0);
+
+    for (index_t cell = 0; cell < SUDOKU_GRID_LENGTH; cell++) {
+        for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+            size_t k = 0;
+            lit_t * imp = this->implies[cell * SUDOKU_NUMBERS + n];
+
+            for (index_t m = 0; m < SUDOKU_NUMBERS; m++) {
+                if (m != n) {
+                    imp[k++] = negative(cell * SUDOKU_NUMBERS + m);
+                }
+            }
+
+            for (auto p: grid::tables.peers[cell]) {
+                imp[k++] = negative(p * SUDOKU_NUMBERS + n);
+            }
+        }
+    }
+
+    lit_t lits[SUDOKU_NUMBERS];
+
+    for (index_t cell = 0; cell < SUDOKU_GRID_LENGTH; cell++) {
+        for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+            lits[n] = positive(cell * SUDOKU_NUMBERS + n);
+        }
+        add_clause(lits, SUDOKU_NUMBERS, false, true);
+    }
+
+    for (auto & house: grid::tables.houses) {
+        for (index_t n = 0; n < SUDOKU_NUMBERS; n++) {
+            for (index_t k = 0; k < SUDOKU_NUMBERS; k++) {
+                lits[k] = positive(house[k] * SUDOKU_NUMBERS + n);
+            }
+            add_clause(lits, SUDOKU_NUMBERS, false, true);
+        }
+    }
+
+    this->static_arena = this->arena.size();
+    this->static_clauses = this->clauses.size();
+
+    this->arena.reserve(this->static_arena + 16 * LEARNT_LIMIT);
+    this->clauses.reserve(this->static_clauses + 2 * LEARNT_LIMIT);
+    this->learnt.reserve(VARIABLES);
+
+    for (auto & w: this->watches) {
+        w.reserve(16);
+    }
+}
+
+size_t
+CdclEngine::solve(
+    const grid_t & values,
+    size_t limit)
+{
+    SUDOKU_TRACE("CdclEngine::solve");
+
+    size_t count = 0;
+
+    reset();
+
+    for (index_t cell = 0; cell < SUDOKU_GRID_LENGTH; cell++) {
+        if (values[cell] == 0) {
+            continue;
+        }
+
+        if (values[cell] > SUDOKU_NUMBERS) {
+            return 0;
+        }
+
+        lit_t lit = positive(cell * SUDOKU_NUMBERS + values[cell] - 1);
+        auto v = value(lit);
+
+        if (v == 0) {
+            return 0;
+        }
+
+        if (v < 0) {
+            enqueue(lit, NO_REASON);
+        }
+    }
+
+    size_t restarts = 0;
+    size_t since_restart = 0;
+    size_t restart_limit = RESTART_BASE * luby(restarts);
+    size_t learnt_limit = LEARNT_LIMIT;
+
+    while (true) {
+        if (interrupted()) {
+            return count;
+        }
+
+        int32_t conflict = propagate();
+
+        if (conflict != NO_CONFLICT) {
+            this->conflicts++;
+            since_restart++;
+
+            if (this->level == 0) {
+                return count;
+            }
+
+            size_t backjump;
+            analyze(conflict, backjump);
+            cancel_until(backjump);
+
+            if (this->learnt.size() == 1) {
+                enqueue(this->learnt[0], NO_REASON);
+            } else {
+                add_clause(this->learnt.data(), this->learnt.size(), true, false);
+                watch(this->clauses.size() - 1);
+                enqueue(this->learnt[0], this->clauses.size() - 1);
+            }
+
+            this->increment /= 0.95;
+            continue;
+        }
+
+        if (since_restart >= restart_limit) {
+            cancel_until(0);
+
+            if (this->clauses.size() - this->static_clauses > learnt_limit) {
+                reduce();
+                learnt_limit += learnt_limit / 10;
+            }
+
+            restarts++;
+            since_restart = 0;
+            restart_limit = RESTART_BASE * luby(restarts);
+            continue;
+        }
+
+        if (!decide()) {
+            if (count == 0) {
+                record();
+            }
+
+            count++;
+
+            if (count >= limit) {
+                return count;
+            }
+
+            // Exclude this solution and look for another one.
+            if (!block_solution()) {
+                return count;
+            }
+        }
+    }
+}
+
+void
+CdclEngine::reset()
+{
+    this->arena.resize(this->static_arena);
+    this->clauses.resize(this->static_clauses);
+
+    for (auto & w: this->watches) {
+        w.clear();
+    }
+
+    for (uint32_t c = 0; c < this->static_clauses; c++) {
+        watch(c);
+    }
+
+    for (size_t v = 0; v < VARIABLES; v++) {
+        this->assigns[v] = -1;
+        this->phase[v] = 1;
+        this->seen[v] = 0;
+        this->activity[v] = 0;
+    }
+
+    this->increment = 1;
+    this->trail_size = 0;
+    this->level = 0;
+    this->qhead = 0;
+    this->conflicts = 0;
+    this->decisions = 0;
+}
+
+void
+CdclEngine::add_clause(
+    const lit_t * lits,
+    size_t n,
+    bool learnt,
+    bool keep)
+{
+    Clause c;
+
+    c.start = this->arena.size();
+    c.size = n;
+    c.learnt = learnt;
+    c.keep = keep;
+
+    this->arena.insert(this->arena.end(), lits, lits + n);
+    this->clauses.push_back(c);
+}
+
+void
+CdclEngine::watch(
+    uint32_t c)
+{
+    const lit_t * lits = &this->arena[this->clauses[c].start];
+
+    this->watches[lits[0]].push_back(c);
+    this->watches[lits[1]].push_back(c);
+}
+
+void
+CdclEngine::enqueue(
+    lit_t lit,
+    int32_t reason)
+{
+    auto v = lit >> 1;
+
+    this->assigns[v] = (lit & 1) ? 0 : 1;
+    this->levels[v] = this->level;
+    this->reasons[v] = reason;
+    this->trail[this->trail_size++] = lit;
+}
+
+int32_t
+CdclEngine::propagate()
+{
+    while (this->qhead < this->trail_size) {
+        lit_t p = this->trail[this->qhead++];
+        lit_t falsified = p ^ 1;
+
+        // Only positive literals have binary implications.
+        if ((p & 1) == 0) {
+            for (auto q: this->implies[p >> 1]) {
+                auto v = value(q);
+
+                if (v == 0) {
+                    this->conflict_binary[0] = q;
+                    this->conflict_binary[1] = falsified;
+                    return BINARY_CONFLICT;
+                }
+
+                if (v < 0) {
+                    enqueue(q, binary_reason(falsified));
+                }
+            }
+        }
+
+        auto & ws = this->watches[falsified];
+        size_t i = 0;
+        size_t j = 0;
+
+        while (i < ws.size()) {
+            uint32_t c = ws[i++];
+            const Clause & clause = this->clauses[c];
+            lit_t * lits = &this->arena[clause.start];
+
+            if (lits[0] == falsified) {
+                std::swap(lits[0], lits[1]);
+            }
+
+            if (value(lits[0]) == 1) {
+                ws[j++] = c;
+                continue;
+            }
+
+            bool found = false;
+
+            for (uint32_t k = 2; k < clause.size; k++) {
+                if (value(lits[k]) != 0) {
+                    std::swap(lits[1], lits[k]);
+                    this->watches[lits[1]].push_back(c);
+                    found = true;
+                    break;
+                }
+            }
+
+            if (found) {
+                continue;
+            }
+
+            ws[j++] = c;
+
+            if (value(lits[0]) == 0) {
+                while (i < ws.size()) {
+                    ws[j++] = ws[i++];
+                }
+                ws.resize(j);
+                this->qhead = this->trail_size;
+                return static_cast<int32_t>(c);
+            }
+
+            enqueue(lits[0], static_cast<int32_t>(c));
+        }
+
+        ws.resize(j);
+    }
+
+    return NO_CONFLICT;
+}
+
+void
+CdclEngine::analyze(
+    int32_t conflict,
+    size_t & backjump)
+{
+    lit_t binary[2];
+    const lit_t * lits;
+    size_t n;
+
+    if (conflict >= 0) {
+        lits = &this->arena[this->clauses[conflict].start];
+        n = this->clauses[conflict].size;
+    } else {
+        lits = this->conflict_binary;
+        n = 2;
+    }
+
+    this->learnt.clear();
+    this->learnt.push_back(0);
+
+    size_t path = 0;
+    size_t index = this->trail_size;
+    lit_t p = ~static_cast<lit_t>(0);
+
+    while (true) {
+        for (size_t k = 0; k < n; k++) {
+            lit_t q = lits[k];
+            auto v = q >> 1;
+
+            if (q == p || this->seen[v] || this->levels[v] == 0) {
+                continue;
+            }
+
+            this->seen[v] = 1;
+            this->activity[v] += this->increment;
+
+            if (this->activity[v] > 1e100) {
+                for (auto & a: this->activity) {
+                    a *= 1e-100;
+                }
+                this->increment *= 1e-100;
+            }
+
+            if (this->levels[v] >= this->level) {
+                path++;
+            } else {
+                this->learnt.push_back(q);
+            }
+        }
+
+        do {
+            index--;
+        } while (!this->seen[this->trail[index] >> 1]);
+
+        p = this->trail[index];
+        this->seen[p >> 1] = 0;
+        path--;
+
+        if (path == 0) {
+            break;
+        }
+
+        int32_t reason = this->reasons[p >> 1];
+
+        if (reason >= 0) {
+            lits = &this->arena[this->clauses[reason].start];
+            n = this->clauses[reason].size;
+        } else {
+            binary[0] = p;
+            binary[1] = binary_other(reason);
+            lits = binary;
+            n = 2;
+        }
+    }
+
+    this->learnt[0] = p ^ 1;
+    backjump = 0;
+
+    if (this->learnt.size() > 1) {
+        size_t best = 1;
+
+        for (size_t k = 2; k < this->learnt.size(); k++) {
+            if (this->levels[this->learnt[k] >> 1] > this->levels[this->learnt[best] >> 1]) {
+                best = k;
+            }
+        }
+
+        std::swap(this->learnt[1], this->learnt[best]);
+        backjump = this->levels[this->learnt[1] >> 1];
+    }
+
+    for (size_t k = 1; k < this->learnt.size(); k++) {
+        this->seen[this->learnt[k] >> 1] = 0;
+    }
+}
+
+void
+CdclEngine::cancel_until(
+    size_t lvl)
+{
+    if (this->level <= lvl) {
+        return;
+    }
+
+    size_t start = this->trail_limits[lvl + 1];
+
+    for (size_t i = this->trail_size; i > start; i--) {
+        auto v = this->trail[i - 1] >> 1;
+
+        this->phase[v] = this->assigns[v];
+        this->assigns[v] = -1;
+    }
+
+    this->trail_size = start;
+    this->qhead = start;
+    this->level = lvl;
+}
+
+bool
+CdclEngine::decide()
+{
+    ssize_t best = -1;
+    double best_activity = -1;
+
+    for (size_t v = 0; v < VARIABLES; v++) {
+        if (this->assigns[v] < 0 && this->activity[v] > best_activity) {
+            best = v;
+            best_activity = this->activity[v];
+        }
+    }
+
+    if (best < 0) {
+        return false;
+    }
+
+    this->decisions++;
+    this->level++;
+    this->trail_limits[this->level] = this->trail_size;
+
+    enqueue(this->phase[best] ? positive(best) : negative(best), NO_REASON);
+
+    return true;
+}
+
+bool
+CdclEngine::block_solution()
+{
+    this->learnt.clear();
+
+    for (size_t v = 0; v < VARIABLES; v++) {
+        if (this->assigns[v] == 1 && this->levels[v] > 0) {
+            this->learnt.push_back(negative(v));
+        }
+    }
+
+    cancel_until(0);
+
+    // Everything was forced at level 0, so there is no other solution.
+    if (this->learnt.empty()) {
+        return false;
+    }
+
+    if (this->learnt.size() == 1) {
+        enqueue(this->learnt[0], NO_REASON);
+    } else {
+        add_clause(this->learnt.data(), this->learnt.size(), true, true);
+        watch(this->clauses.size() - 1);
+    }
+
+    return true;
+}
+
+void
+CdclEngine::reduce()
+{
+    // Keep the shorter half of the learnt clauses.  Called at decision
+    // level 0 right after a conflict free propagation, so every clause
+    // is either satisfied or has at least two unassigned literals.
+    size_t learnts = 0;
+    size_t sizes[SUDOKU_NUMBERS + 2] = { 0 };
+
+    for (size_t c = this->static_clauses; c < this->clauses.size(); c++) {
+        if (!this->clauses[c].keep) {
+            sizes[std::min<size_t>(this->clauses[c].size, SUDOKU_NUMBERS + 1)]++;
+            learnts++;
+        }
+    }
+
+    size_t threshold = 0;
+
+    for (size_t kept = 0; threshold <= SUDOKU_NUMBERS + 1; threshold++) {
+        kept += sizes[threshold];
+
+        if (kept >= learnts / 2) {
+            break;
+        }
+    }
+
+    size_t out_clause = this->static_clauses;
+    size_t out_lit = this->static_arena;
+
+    for (size_t c = this->static_clauses; c < this->clauses.size(); c++) {
+        Clause clause = this->clauses[c];
+
+        if (!clause.keep && clause.size > threshold) {
+            continue;
+        }
+
+        std::copy(this->arena.begin() + clause.start,
+                  this->arena.begin() + clause.start + clause.size,
+                  this->arena.begin() + out_lit);
+        clause.start = out_lit;
+        out_lit += clause.size;
+        this->clauses[out_clause++] = clause;
+    }
+
+    this->arena.resize(out_lit);
+    this->clauses.resize(out_clause);
+
+    for (auto & w: this->watches) {
+        w.clear();
+    }
+
+    for (uint32_t c = 0; c < this->clauses.size(); c++) {
+        lit_t * lits = &this->arena[this->clauses[c].start];
+        size_t n = this->clauses[c].size;
+        bool satisfied = false;
+        size_t free = 0;
+
+        for (size_t k = 0; k < n; k++) {
+            auto v = value(lits[k]);
+
+            if (v == 1) {
+                satisfied = true;
+                break;
+            }
+
+            if (v < 0) {
+                std::swap(lits[free++], lits[k]);
+            }
+        }
+
+        if (satisfied || free >= 2) {
+            watch(c);
+        }
+    }
+
+    for (size_t i = 0; i < this->trail_size; i++) {
+        this->reasons[this->trail[i] >> 1] = NO_REASON;
+    }
+}
+
+void
+CdclEngine::record()
+{
+    for (size_t v = 0; v < VARIABLES; v++) {
+        if (this->assigns[v] == 1) {
+            this->solution[v / SUDOKU_NUMBERS] = v % SUDOKU_NUMBERS + 1;
+        }
+    }
+}
@@ -0,0 +1,120 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef CDCL_H
+#define CDCL_H
+
+#include <vector>
+
+#include "engine.h"
+
+namespace sudoku {
+    namespace cdcl {
+        // Conflict driven clause learning over the 729 boolean variables
+        // "cell holds number".  Every cell holds at least one number and
+        // every house has every number somewhere; those are the long
+        // clauses and they are watched with two literals each.  The "at
+        // most one" constraints are binary and do not change between
+        // puzzles, so they are kept as fixed implication tables.
+        //
+        // Conflicts are analysed to the first unique implication point,
+        // the learnt clause is added and the search jumps back.  Restarts
+        // follow the Luby sequence and shrink the learnt clause database,
+        // which keeps the work per puzzle bounded on adversarial input.
+        class CdclEngine : public engine::Engine
+        {
+        public:
+            CdclEngine();
+
+            virtual size_t solve(const grid_t & values, size_t limit = 2);
+
+            virtual const grid_t & get_solution() const {
+                return this->solution;
+            }
+
+            size_t get_conflicts() const {
+                return this->conflicts;
+            }
+
+            size_t get_decisions() const {
+                return this->decisions;
+            }
+
+        private:
+            typedef uint32_t lit_t;
+
+            static const size_t VARIABLES = SUDOKU_GRID_LENGTH * SUDOKU_NUMBERS;
+            static const size_t LITERALS = 2 * VARIABLES;
+            static const size_t IMPLICATIONS = (SUDOKU_NUMBERS - 1) + SUDOKU_PEERS;
+
+            struct Clause {
+                uint32_t start;
+                uint32_t size;
+                bool learnt;
+                bool keep;
+            };
+
+            void reset();
+            void add_clause(const lit_t * lits, size_t n, bool learnt, bool keep);
+            void watch(uint32_t c);
+            void enqueue(lit_t lit, int32_t reason);
+            int32_t propagate();
+            void analyze(int32_t conflict, size_t & backjump);
+            void cancel_until(size_t lvl);
+            bool decide();
+            bool block_solution();
+            void reduce();
+            void record();
+
+            int8_t value(lit_t lit) const {
+                int8_t a = this->assigns[lit >> 1];
+                return a < 0 ? a : a ^ static_cast<int8_t>(lit & 1);
+            }
+
+            // Unit "at most one" implications of each positive literal.
+            lit_t implies[VARIABLES][IMPLICATIONS];
+
+            std::vector<lit_t> arena;
+            std::vector<Clause> clauses;
+            std::vector<uint32_t> watches[LITERALS];
+            size_t static_arena;
+            size_t static_clauses;
+
+            int8_t assigns[VARIABLES];
+            int8_t phase[VARIABLES];
+            uint8_t seen[VARIABLES];
+            uint32_t levels[VARIABLES];
+            int32_t reasons[VARIABLES];
+            double activity[VARIABLES];
+            double increment;
+
+            lit_t trail[VARIABLES];
+            size_t trail_size;
+            size_t trail_limits[VARIABLES + 1];
+            size_t level;
+            size_t qhead;
+
+            lit_t conflict_binary[2];
+            std::vector<lit_t> learnt;
+
+            grid_t solution;
+            size_t conflicts;
+            size_t decisions;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,278 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "client.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace sudoku;
+using namespace sudoku::protocol;
+
+namespace {
+    // Records per request of solve_batch(), and requests in flight.
+    // Their responses stay well below what the server buffers for a
+    // connection that is not read.
+    const size_t REQUEST_RECORDS = 512;
+    const size_t IN_FLIGHT = 16;
+}
+
+Client::~Client()
+{
+    if (this->fd >= 0) {
+        close(this->fd);
+    }
+}
+
+bool
+Client::connect(
+    const std::string & path)
+{
+    sockaddr_un address;
+
+    if (path.size() >= sizeof(address.sun_path)) {
+        this->error = path + ": Path too long";
+        return false;
+    }
+
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+
+    if (this->fd >= 0) {
+        close(this->fd);
+    }
+
+    this->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (this->fd < 0
+        || ::connect(this->fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        this->error = path + ": " + std::strerror(errno);
+
+        if (this->fd >= 0) {
+            close(this->fd);
+            this->fd = -1;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+bool
+Client::write_all(
+    const void * data,
+    size_t length)
+{
+    const char * p = static_cast<const char *>(data);
+
+    while (length > 0) {
+        ssize_t n = ::send(this->fd, p, length, MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            this->error = std::strerror(errno);
+            return false;
+        }
+
+        p += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+bool
+Client::read_all(
+    void * data,
+    size_t length)
+{
+    char * p = static_cast<char *>(data);
+
+    while (length > 0) {
+        ssize_t n = read(this->fd, p, length);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            this->error = n < 0 ? std::strerror(errno) : "Connection closed";
+            return false;
+        }
+
+        p += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+bool
+Client::send_solve(
+    uint32_t id,
+    const char * records,
+    size_t n)
+{
+    if (n > MAX_COUNT) {
+        this->error = "Too many records in a request";
+        return false;
+    }
+
+    std::vector<uint8_t> request(sizeof(Header) + n * packed::PACKED_LENGTH);
+    Header header = { id, Type::Solve, Result::Ok, static_cast<uint16_t>(n) };
+
+    std::memcpy(request.data(), &header, sizeof(header));
+
+    for (size_t i = 0; i < n; i++) {
+        packed::pack(records + i * RECORD_LENGTH,
+                     &request[sizeof(Header) + i * packed::PACKED_LENGTH]);
+    }
+
+    return write_all(request.data(), request.size());
+}
+
+bool
+Client::send_metrics(
+    uint32_t id)
+{
+    Header header = { id, Type::Metrics, Result::Ok, 0 };
+
+    return write_all(&header, sizeof(header));
+}
+
+bool
+Client::receive(
+    Response & response)
+{
+    auto & header = response.header;
+
+    if (!read_all(&header, sizeof(header))) {
+        return false;
+    }
+
+    if (header.result != Result::Ok) {
+        this->error = "Bad request";
+        return false;
+    }
+
+    if (header.type == Type::Metrics) {
+        return read_all(&response.metrics, sizeof(response.metrics));
+    }
+
+    std::vector<uint8_t> body(header.count * SOLUTION_LENGTH);
+
+    if (!read_all(body.data(), body.size())) {
+        return false;
+    }
+
+    response.records.resize(header.count * RECORD_LENGTH);
+    response.status.resize(header.count);
+
+    for (size_t i = 0; i < header.count; i++) {
+        response.status[i] = static_cast<Status>(body[i * SOLUTION_LENGTH]);
+        packed::unpack(&body[i * SOLUTION_LENGTH + 1], &response.records[i * RECORD_LENGTH]);
+    }
+
+    return true;
+}
+
+bool
+Client::solve_batch(
+    const char * in,
+    size_t n,
+    char * out,
+    Status * status)
+{
+    SUDOKU_TRACE("Client::solve_batch");
+
+    size_t requests = (n + REQUEST_RECORDS - 1) / REQUEST_RECORDS;
+    uint32_t first = this->next_id;
+    size_t sent = 0;
+    size_t received = 0;
+    Response response;
+
+    this->next_id += requests;
+
+    while (received < requests) {
+        while (sent < requests && sent - received < IN_FLIGHT) {
+            size_t offset = sent * REQUEST_RECORDS;
+
+            if (!send_solve(first + sent, in + offset * RECORD_LENGTH,
+                            std::min(REQUEST_RECORDS, n - offset))) {
+                return false;
+            }
+            sent++;
+        }
+
+        if (!receive(response)) {
+            return false;
+        }
+
+        size_t offset = static_cast<uint32_t>(response.header.id - first) * REQUEST_RECORDS;
+
+        if (response.header.type != Type::Solve || offset >= n
+            || response.header.count != std::min(REQUEST_RECORDS, n - offset)) {
+            this->error = "Unexpected response";
+            return false;
+        }
+
+        std::memcpy(out + offset * RECORD_LENGTH, response.records.data(),
+                    response.records.size());
+
+        if (status != nullptr) {
+            std::copy(response.status.begin(), response.status.end(), status + offset);
+        }
+
+        received++;
+    }
+
+    return true;
+}
+
+bool
+Client::get_metrics(
+    Metrics & metrics)
+{
+    Response response;
+    uint32_t id = this->next_id++;
+
+    if (!send_metrics(id) || !receive(response)) {
+        return false;
+    }
+
+    if (response.header.type != Type::Metrics || response.header.id != id) {
+        this->error = "Unexpected response";
+        return false;
+    }
+
+    metrics = response.metrics;
+
+    return true;
+}
@@ -0,0 +1,76 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <string>
+#include <vector>
+
+#include "protocol.h"
+
+namespace sudoku {
+    // A blocking connection to a Server.
+    class Client
+    {
+    public:
+        struct Response {
+            protocol::Header header;
+            // header.count records and their statuses for Solve.
+            std::vector<char> records;
+            std::vector<Status> status;
+            protocol::Metrics metrics;
+        };
+
+        Client() : fd(-1), next_id(0) {}
+        ~Client();
+
+        Client(const Client &) = delete;
+        Client & operator=(const Client &) = delete;
+
+        bool connect(const std::string & path);
+
+        // Send requests without waiting for the responses.  At most
+        // protocol::MAX_COUNT records.
+        bool send_solve(uint32_t id, const char * records, size_t n);
+        bool send_metrics(uint32_t id);
+
+        // Waits for the next response.  A BadRequest response is
+        // returned as an error.
+        bool receive(Response & response);
+
+        // Like BatchSolver::solve_batch(), but for any number of records,
+        // a few requests at a time.  Returns false on an error.  Must not
+        // be mixed with requests sent before.
+        bool solve_batch(const char * in, size_t n, char * out, Status * status);
+
+        bool get_metrics(protocol::Metrics & metrics);
+
+        const std::string & get_error() const {
+            return this->error;
+        }
+
+    private:
+        bool write_all(const void * data, size_t length);
+        bool read_all(void * data, size_t length);
+
+        int fd;
+        uint32_t next_id;
+        std::string error;
+    };
+}
+
+#endif
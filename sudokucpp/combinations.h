@@ -17,8 +17,12 @@
 #ifndef COMBINATIONS_H
 #define COMBINATIONS_H
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <experimental/optional>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 
 namespace sudoku {
@@ -33,7 +37,8 @@ namespace sudoku {
             bool visit_flag;
 
             // newCombination initialize a combination generator of length elements.
-            Combination(ssize_t length, ssize_t koo) : length(length), koo(koo), j(koo), k(koo) {
+            Combination(ssize_t length, ssize_t koo) : length(length), koo(koo), j(koo), k(koo),
+                                                     visit_flag(true) {
                 for (ssize_t i = 0; i <= koo; i++) {
                     this->cjs.push_back(i - 1);
                 }
@@ -107,6 +112,218 @@ namespace sudoku {
                 return this->visit();
             }
         };
+
+        // Combinations of k elements out of n as bitmasks, bit i set when
+        // element i is part of the combination.
+        typedef uint32_t subset_t;
+
+        const size_t MAX_ELEMENTS = 32;
+
+        inline void check_elements(size_t n, size_t k) {
+            if (n > MAX_ELEMENTS || k > MAX_ELEMENTS) {
+                throw std::invalid_argument("Too many elements for a combination");
+            }
+        }
+
+        // Gosper's hack: the next larger mask with the same number of bits.
+        inline uint64_t next_subset(uint64_t m) {
+            uint64_t c = m & -m;
+            uint64_t r = m + c;
+
+            return (((r ^ m) >> 2) / c) | r;
+        }
+
+        // All k element subsets of n <= MAX_ELEMENTS elements in colex
+        // order, without allocating.  Throws std::invalid_argument for
+        // larger n or k.
+        //
+        //     for (auto m: MaskRange(9, 3)) { ... }
+        class MaskRange
+        {
+        public:
+            class iterator
+            {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef subset_t value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const subset_t * pointer;
+                typedef subset_t reference;
+
+                iterator(uint64_t mask, uint64_t end) : mask(mask), end(end) {}
+
+                subset_t operator*() const {
+                    return static_cast<subset_t>(this->mask);
+                }
+
+                iterator & operator++() {
+                    // The empty set has no successor.
+                    this->mask = this->mask == 0 ? this->end : next_subset(this->mask);
+
+                    if (this->mask > this->end) {
+                        this->mask = this->end;
+                    }
+                    return *this;
+                }
+
+                iterator operator++(int) {
+                    iterator it = *this;
+                    ++*this;
+                    return it;
+                }
+
+                bool operator==(const iterator & other) const {
+                    return this->mask == other.mask;
+                }
+
+                bool operator!=(const iterator & other) const {
+                    return this->mask != other.mask;
+                }
+
+            private:
+                uint64_t mask;
+                uint64_t end;
+            };
+
+            MaskRange(size_t n, size_t k) {
+                check_elements(n, k);
+
+                this->first = k <= n ? (uint64_t(1) << k) - 1 : uint64_t(1) << n;
+                this->last = uint64_t(1) << n;
+            }
+
+            iterator begin() const {
+                return iterator(this->first, this->last);
+            }
+
+            iterator end() const {
+                return iterator(this->last, this->last);
+            }
+
+        private:
+            uint64_t first;
+            uint64_t last;
+        };
+
+        // Elements of a combination, in increasing order.
+        struct Indices
+        {
+            std::array<uint8_t, MAX_ELEMENTS> items;
+            size_t length;
+
+            size_t size() const {
+                return this->length;
+            }
+
+            uint8_t operator[](size_t i) const {
+                return this->items[i];
+            }
+
+            const uint8_t * begin() const {
+                return this->items.data();
+            }
+
+            const uint8_t * end() const {
+                return this->items.data() + this->length;
+            }
+
+            subset_t mask() const {
+                subset_t m = 0;
+
+                for (auto i: *this) {
+                    m |= subset_t(1) << i;
+                }
+                return m;
+            }
+        };
+
+        // All k element subsets of n <= MAX_ELEMENTS elements as index
+        // arrays in lexicographic order, updated in place.  Throws
+        // std::invalid_argument for larger n or k.
+        //
+        //     for (auto & c: IndexRange(9, 3)) { c[0], c[1], c[2] ... }
+        class IndexRange
+        {
+        public:
+            class iterator
+            {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef Indices value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const Indices * pointer;
+                typedef const Indices & reference;
+
+                iterator(size_t n, size_t k, bool done) : n(n), done(done) {
+                    this->current.length = k;
+
+                    for (size_t i = 0; i < k; i++) {
+                        this->current.items[i] = i;
+                    }
+                }
+
+                const Indices & operator*() const {
+                    return this->current;
+                }
+
+                const Indices * operator->() const {
+                    return &this->current;
+                }
+
+                iterator & operator++() {
+                    auto & c = this->current.items;
+                    size_t k = this->current.length;
+                    size_t i = k;
+
+                    // The rightmost element that can still be moved right.
+                    while (i > 0 && c[i - 1] == this->n - k + i - 1) {
+                        i--;
+                    }
+
+                    if (i == 0) {
+                        this->done = true;
+                        return *this;
+                    }
+
+                    c[i - 1]++;
+
+                    for (size_t j = i; j < k; j++) {
+                        c[j] = c[j - 1] + 1;
+                    }
+                    return *this;
+                }
+
+                bool operator==(const iterator & other) const {
+                    return this->done == other.done
+                        && (this->done || this->current.mask() == other.current.mask());
+                }
+
+                bool operator!=(const iterator & other) const {
+                    return !(*this == other);
+                }
+
+            private:
+                Indices current;
+                size_t n;
+                bool done;
+            };
+
+            IndexRange(size_t n, size_t k) : n(n), k(k) {
+                check_elements(n, k);
+            }
+
+            iterator begin() const {
+                return iterator(this->n, this->k, this->k > this->n);
+            }
+
+            iterator end() const {
+                return iterator(this->n, this->k, true);
+            }
+
+        private:
+            size_t n;
+            size_t k;
+        };
     }
 }
 
@@ -0,0 +1,242 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "config.h"
+#include "dlx.h"
+
+using namespace sudoku;
+using namespace sudoku::dlx;
+
+const size_t DancingLinks::ROWS;
+const size_t DancingLinks::COLUMNS;
+const size_t DancingLinks::NODES;
+
+DancingLinks::DancingLinks() : puzzle(nullptr), count(0), nodes(0)
+{
+    this->solution.fill(0);
+
+    // Node 0 is the root, nodes 1..COLUMNS the column headers.
+    for (size_t i = 0; i <= COLUMNS; i++) {
+        left[i] = i == 0 ? COLUMNS : i - 1;
+        right[i] = i == COLUMNS ? 0 : i + 1;
+        up[i] = i;
+        down[i] = i;
+        column[i] = i;
+        row[i] = 0;
+        size[i] = 0;
+    }
+
+    node_t n = COLUMNS + 1;
+
+    for (size_t r = 0; r < ROWS; r++) {
+        index_t cell = r / SUDOKU_NUMBERS;
+        index_t number = r % SUDOKU_NUMBERS;
+
+        node_t cols[4] = {
+            static_cast<node_t>(1 + cell),
+            static_cast<node_t>(1 + SUDOKU_GRID_LENGTH
+                                + grid::tables.row[cell] * SUDOKU_NUMBERS + number),
+            static_cast<node_t>(1 + 2 * SUDOKU_GRID_LENGTH
+                                + grid::tables.column[cell] * SUDOKU_NUMBERS + number),
+            static_cast<node_t>(1 + 3 * SUDOKU_GRID_LENGTH
+                                + grid::tables.box[cell] * SUDOKU_NUMBERS + number)
+        };
+
+        row_first[r] = n;
+
+        for (node_t k = 0; k < 4; k++) {
+            node_t x = n + k;
+            node_t c = cols[k];
+
+            column[x] = c;
+            row[x] = r;
+
+            up[x] = up[c];
+            down[x] = c;
+            down[up[c]] = x;
+            up[c] = x;
+            size[c]++;
+
+            left[x] = n + (k + 3) % 4;
+            right[x] = n + (k + 1) % 4;
+        }
+
+        n += 4;
+    }
+}
+
+void
+DancingLinks::cover(
+    node_t c)
+{
+    right[left[c]] = right[c];
+    left[right[c]] = left[c];
+
+    for (node_t i = down[c]; i != c; i = down[i]) {
+        for (node_t j = right[i]; j != i; j = right[j]) {
+            down[up[j]] = down[j];
+            up[down[j]] = up[j];
+            size[column[j]]--;
+        }
+    }
+}
+
+void
+DancingLinks::uncover(
+    node_t c)
+{
+    for (node_t i = up[c]; i != c; i = up[i]) {
+        for (node_t j = left[i]; j != i; j = left[j]) {
+            size[column[j]]++;
+            down[up[j]] = j;
+            up[down[j]] = j;
+        }
+    }
+
+    right[left[c]] = c;
+    left[right[c]] = c;
+}
+
+size_t
+DancingLinks::solve(
+    const grid_t & values,
+    size_t limit)
+{
+    SUDOKU_TRACE("DancingLinks::solve");
+
+    node_t given[SUDOKU_GRID_LENGTH];
+    size_t ngiven = 0;
+    bool ok = true;
+
+    this->puzzle = &values;
+    this->count = 0;
+    this->nodes = 0;
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH && ok; i++) {
+        if (values[i] == 0) {
+            continue;
+        }
+
+        if (values[i] > SUDOKU_NUMBERS) {
+            ok = false;
+            break;
+        }
+
+        node_t x = row_first[i * SUDOKU_NUMBERS + values[i] - 1];
+
+        // A covered column means that an earlier given conflicts with this one.
+        for (node_t k = 0; k < 4; k++) {
+            node_t c = column[x + k];
+
+            if (right[left[c]] != c) {
+                ok = false;
+            }
+        }
+
+        if (ok) {
+            for (node_t k = 0; k < 4; k++) {
+                cover(column[x + k]);
+            }
+            given[ngiven++] = x;
+        }
+    }
+
+    if (ok) {
+        search(0, limit);
+    }
+
+    while (ngiven > 0) {
+        node_t x = given[--ngiven];
+
+        for (node_t k = 4; k > 0; k--) {
+            uncover(column[x + k - 1]);
+        }
+    }
+
+    this->puzzle = nullptr;
+
+    return this->count;
+}
+
+bool
+DancingLinks::search(
+    index_t k,
+    size_t limit)
+{
+    if (right[0] == 0) {
+        if (this->count == 0) {
+            record(k);
+        }
+
+        this->count++;
+        return this->count >= limit;
+    }
+
+    if (interrupted()) {
+        return true;
+    }
+
+    this->nodes++;
+
+    node_t c = right[0];
+    node_t best = size[c];
+
+    for (node_t j = right[c]; j != 0 && best > 1; j = right[j]) {
+        if (size[j] < best) {
+            c = j;
+            best = size[j];
+        }
+    }
+
+    if (best == 0) {
+        return false;
+    }
+
+    cover(c);
+
+    bool stop = false;
+
+    for (node_t r = down[c]; r != c && !stop; r = down[r]) {
+        selected[k] = r;
+
+        for (node_t j = right[r]; j != r; j = right[j]) {
+            cover(column[j]);
+        }
+
+        stop = search(k + 1, limit);
+
+        for (node_t j = left[r]; j != r; j = left[j]) {
+            uncover(column[j]);
+        }
+    }
+
+    uncover(c);
+
+    return stop;
+}
+
+void
+DancingLinks::record(
+    index_t k)
+{
+    this->solution = *this->puzzle;
+
+    for (index_t i = 0; i < k; i++) {
+        node_t r = row[selected[i]];
+
+        this->solution[r / SUDOKU_NUMBERS] = r % SUDOKU_NUMBERS + 1;
+    }
+}
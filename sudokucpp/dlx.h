@@ -0,0 +1,77 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef DLX_H
+#define DLX_H
+
+#include "engine.h"
+
+namespace sudoku {
+    namespace dlx {
+        // Knuth's Algorithm X with dancing links over the exact cover
+        // matrix of sudoku: 729 rows (cell, number) and 324 columns (cell,
+        // row-number, column-number and box-number constraints).
+        //
+        // The matrix is built once by the constructor.  Givens are
+        // covered before the search and uncovered after it, which leaves
+        // the links as they were, so the same instance solves any number
+        // of puzzles without rebuilding.
+        class DancingLinks : public engine::Engine
+        {
+        public:
+            DancingLinks();
+
+            virtual size_t solve(const grid_t & values, size_t limit = 2);
+
+            virtual const grid_t & get_solution() const {
+                return this->solution;
+            }
+
+            size_t get_nodes() const {
+                return this->nodes;
+            }
+
+        private:
+            typedef uint16_t node_t;
+
+            static const size_t ROWS = SUDOKU_GRID_LENGTH * SUDOKU_NUMBERS;
+            static const size_t COLUMNS = 4 * SUDOKU_GRID_LENGTH;
+            static const size_t NODES = 1 + COLUMNS + 4 * ROWS;
+
+            void cover(node_t c);
+            void uncover(node_t c);
+            bool search(index_t k, size_t limit);
+            void record(index_t k);
+
+            node_t left[NODES];
+            node_t right[NODES];
+            node_t up[NODES];
+            node_t down[NODES];
+            node_t column[NODES];
+            node_t row[NODES];
+            node_t size[1 + COLUMNS];
+            node_t row_first[ROWS];
+
+            node_t selected[SUDOKU_GRID_LENGTH];
+            const grid_t * puzzle;
+            grid_t solution;
+            size_t count;
+            size_t nodes;
+        };
+    }
+}
+
+#endif
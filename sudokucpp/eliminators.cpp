@@ -26,7 +26,7 @@ Result
 SimpleSingles::eliminate(
     const CellGetter & solved,
     const CellGetter & candidates) {
-    ACE_TRACE(ACE_TEXT("SimpleSingles::eliminate"));
+    SUDOKU_TRACE("SimpleSingles::eliminate");
 
     std::map<Position, cells_t> pos_cell_map;
     Result result;
@@ -48,7 +48,7 @@ Result
 Singles::eliminate(
     const CellGetter & solved,
     const CellGetter & candidates) {
-    ACE_TRACE(ACE_TEXT("Singles::eliminate"));
+    SUDOKU_TRACE("Singles::eliminate");
 
     Result result;
 
@@ -17,6 +17,8 @@
 #ifndef ELIMINATORS_H
 #define ELIMINATORS_H
 
+#include <limits>
+
 #include "sudoku.h"
 
 namespace sudoku {
@@ -30,21 +32,71 @@ namespace sudoku {
         class Eliminator
         {
         public:
+            virtual ~Eliminator() {}
+
+            virtual const char * name() const = 0;
             virtual Result eliminate(const CellGetter & solved,
                                      const CellGetter & candidates) = 0;
         };
 
         class SimpleSingles : public Eliminator {
         public:
+            virtual const char * name() const {
+                return "SimpleSingles";
+            }
+
             virtual Result eliminate(const CellGetter & solved,
                                      const CellGetter & candidates);
         };
 
         class Singles : public Eliminator {
         public:
+            virtual const char * name() const {
+                return "Singles";
+            }
+
             virtual Result eliminate(const CellGetter & solved,
                                      const CellGetter & candidates);
         };
+
+        // Runtime statistics of one eliminator.
+        struct Statistics
+        {
+            const char * name;
+            size_t calls;
+            size_t hits;
+            size_t solved;
+            size_t eliminated;
+            uint64_t nanoseconds;
+
+            // Solved and eliminated candidates per nanosecond.  Techniques
+            // that have not been tried yet rank first so that they get
+            // measured.
+            double yield() const {
+                if (calls == 0) {
+                    return std::numeric_limits<double>::infinity();
+                }
+                return static_cast<double>(solved + eliminated) / (nanoseconds + 1);
+            }
+        };
+
+        // Statistics indexed by the position of the eliminator in a
+        // Solver.  Solvers register the same eliminators in the same
+        // order, so one profile can be shared to learn over a batch.
+        struct Profile
+        {
+            std::vector<Statistics> statistics;
+            // Ordering::AdaptiveSkip skips an eliminator after this many
+            // calls when its yield is at most min_yield, by default when
+            // it has never made progress.
+            size_t trials = 32;
+            double min_yield = 0;
+
+            bool unproductive(size_t i) const {
+                const Statistics & st = statistics[i];
+                return st.calls >= trials && st.yield() <= min_yield;
+            }
+        };
     }
 }
 
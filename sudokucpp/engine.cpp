@@ -0,0 +1,58 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "config.h"
+#include "engine.h"
+#include "backtrack.h"
+#include "bitboard.h"
+#include "cdcl.h"
+#include "dlx.h"
+
+using namespace sudoku;
+
+std::shared_ptr<engine::Engine>
+engine::make_engine(
+    Backend backend)
+{
+    switch (backend) {
+    case Backend::Backtracking:
+        return std::make_shared<backtrack::Backtracker>();
+    case Backend::DancingLinks:
+        return std::make_shared<dlx::DancingLinks>();
+    case Backend::Bitboard:
+        return std::make_shared<bitboard::BandEngine>();
+    case Backend::Cdcl:
+        return std::make_shared<cdcl::CdclEngine>();
+    case Backend::Logic:
+        break;
+    }
+
+    return nullptr;
+}
+
+engine::Engine *
+engine::thread_engine(
+    Backend backend)
+{
+    thread_local std::shared_ptr<Engine> engines[static_cast<size_t>(Backend::Cdcl) + 1];
+    auto & e = engines[static_cast<size_t>(backend)];
+
+    if (!e) {
+        e = make_engine(backend);
+    }
+
+    return e.get();
+}
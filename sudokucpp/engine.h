@@ -0,0 +1,85 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "grid.h"
+
+namespace sudoku {
+    namespace engine {
+        // Common interface of the search based backends.  An engine keeps
+        // its working state between calls, so one instance can be reused
+        // for any number of puzzles.
+        class Engine
+        {
+        public:
+            Engine() : limits(nullptr) {}
+            virtual ~Engine() {}
+
+            // Checked once per search node; a search that hits a limit
+            // returns the solutions found so far.
+            void set_limits(Limits * limits) {
+                this->limits = limits;
+            }
+
+            // Returns the number of solutions found, at most limit.
+            virtual size_t solve(const grid_t & values, size_t limit = 2) = 0;
+
+            // The first solution found by the last successful solve().
+            virtual const grid_t & get_solution() const = 0;
+
+        protected:
+            bool interrupted() {
+                return this->limits != nullptr && this->limits->step();
+            }
+
+            Limits * limits;
+        };
+
+        // nullptr for Backend::Logic, which is not search based.
+        std::shared_ptr<Engine> make_engine(Backend backend);
+
+        // The engine of backend for the calling thread, made on first use
+        // and kept until the thread exits, so that objects that solve one
+        // puzzle each, like Solver, do not build one every time.  It
+        // outlives them, so set its limits with a LimitsGuard.
+        Engine * thread_engine(Backend backend);
+
+        // Sets the limits of an engine while in scope and clears them
+        // after, so that the engine does not keep a pointer to limits
+        // that go away before it.
+        class LimitsGuard
+        {
+        public:
+            LimitsGuard(Engine * engine, Limits * limits) : engine(engine) {
+                engine->set_limits(limits);
+            }
+
+            ~LimitsGuard() {
+                this->engine->set_limits(nullptr);
+            }
+
+            LimitsGuard(const LimitsGuard &) = delete;
+            LimitsGuard & operator=(const LimitsGuard &) = delete;
+
+        private:
+            Engine * engine;
+        };
+    }
+}
+
+#endif
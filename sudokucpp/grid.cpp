@@ -0,0 +1,123 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <ostream>
+
+#include "config.h"
+#include "grid.h"
+
+using namespace sudoku;
+
+namespace {
+    constexpr grid::Tables
+    make_tables()
+    {
+        grid::Tables t{};
+
+        for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+            index_t r = i / SUDOKU_NUMBERS;
+            index_t c = i % SUDOKU_NUMBERS;
+            index_t b = (r / SUDOKU_BOXES) * SUDOKU_BOXES + c / SUDOKU_BOXES;
+
+            t.row[i] = r;
+            t.column[i] = c;
+            t.box[i] = b;
+
+            t.houses[r][c] = i;
+            t.houses[SUDOKU_NUMBERS + c][r] = i;
+            t.houses[2 * SUDOKU_NUMBERS + b][(r % SUDOKU_BOXES) * SUDOKU_BOXES
+                                             + c % SUDOKU_BOXES] = i;
+        }
+
+        for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+            index_t n = 0;
+
+            for (index_t j = 0; j < SUDOKU_GRID_LENGTH; j++) {
+                if (i != j && (t.row[i] == t.row[j] || t.column[i] == t.column[j]
+                               || t.box[i] == t.box[j])) {
+                    t.peers[i][n++] = j;
+                }
+            }
+        }
+
+        return t;
+    }
+}
+
+const grid::Tables sudoku::grid::tables = make_tables();
+
+bool
+sudoku::parse_grid(
+    const char * str,
+    size_t length,
+    grid_t & grid)
+{
+    if (length != SUDOKU_GRID_LENGTH) {
+        return false;
+    }
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        char c = str[i];
+
+        if (c >= '1' && c <= '9') {
+            grid[i] = c - '0';
+        } else if (c == '0' || c == '.') {
+            grid[i] = 0;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+sudoku::format_grid(
+    const grid_t & grid,
+    char * str)
+{
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        str[i] = '0' + grid[i];
+    }
+}
+
+void
+sudoku::print_grid(
+    std::ostream & os,
+    const grid_t & grid)
+{
+    os << "+-------------------+" << std::endl;
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        if ((i + 1) % 9 == 1) {
+            os << "| ";
+        }
+
+        if (grid[i] == 0) {
+            os << ".";
+        } else {
+            os << static_cast<int>(grid[i]);
+        }
+
+        if ((i + 1) % 9 == 0) {
+            os << " |" << std::endl;
+        } else {
+            os << " ";
+        }
+    }
+
+    os << "+-------------------+" << std::endl;
+}
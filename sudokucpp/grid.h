@@ -0,0 +1,69 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef GRID_H
+#define GRID_H
+
+#include <iosfwd>
+
+#include "sudoku.h"
+
+namespace sudoku {
+    const mask_t ALL_CANDIDATES = (1 << SUDOKU_NUMBERS) - 1;
+
+    const index_t SUDOKU_PEERS = 20;
+
+    inline mask_t number_mask(index_t n) {
+        return static_cast<mask_t>(1 << (n - 1));
+    }
+
+    inline index_t mask_number(mask_t m) {
+        return static_cast<index_t>(__builtin_ctz(m) + 1);
+    }
+
+    inline index_t mask_count(mask_t m) {
+        return static_cast<index_t>(__builtin_popcount(m));
+    }
+
+    inline index_t cell_index(const Position & p) {
+        return (p.row - 1) * SUDOKU_NUMBERS + (p.column - 1);
+    }
+
+    // Reads SUDOKU_GRID_LENGTH characters, '1'-'9' for the givens and '0'
+    // or '.' for unsolved cells.  Returns false on any other input.
+    bool parse_grid(const char * str, size_t length, grid_t & grid);
+
+    // Writes SUDOKU_GRID_LENGTH characters, '0' for unsolved cells.
+    void format_grid(const grid_t & grid, char * str);
+
+    void print_grid(std::ostream & os, const grid_t & grid);
+
+    namespace grid {
+        // Zero-based lookup tables for the cell indices of a grid.
+        // Houses 0-8 are the rows, 9-17 the columns and 18-26 the boxes.
+        struct Tables {
+            index_t row[SUDOKU_GRID_LENGTH];
+            index_t column[SUDOKU_GRID_LENGTH];
+            index_t box[SUDOKU_GRID_LENGTH];
+            index_t houses[SUDOKU_HOUSES][SUDOKU_NUMBERS];
+            index_t peers[SUDOKU_GRID_LENGTH][SUDOKU_PEERS];
+        };
+
+        extern const Tables tables;
+    }
+}
+
+#endif
@@ -0,0 +1,164 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <ostream>
+
+#include "config.h"
+#include "instrument.h"
+
+using namespace sudoku;
+using namespace sudoku::instrument;
+
+#if SUDOKU_INSTRUMENTATION
+const bool sudoku::instrument::enabled = true;
+#else
+const bool sudoku::instrument::enabled = false;
+#endif
+
+namespace {
+    void
+    write_counters(
+        std::ostream & os,
+        const Counters & c)
+    {
+        size_t used = HISTOGRAM_BUCKETS;
+
+        while (used > 0 && c.latency.buckets[used - 1] == 0) {
+            used--;
+        }
+
+        os << "{\"calls\": " << c.calls
+           << ", \"hits\": " << c.hits
+           << ", \"placements\": " << c.placements
+           << ", \"eliminations\": " << c.eliminations
+           << ", \"nanoseconds\": " << c.nanoseconds
+           << ", \"latency_log2_ns\": [";
+
+        for (size_t i = 0; i < used; i++) {
+            os << (i > 0 ? ", " : "") << c.latency.buckets[i];
+        }
+
+        os << "]}";
+    }
+}
+
+void
+Histogram::add(
+    uint64_t nanoseconds)
+{
+    size_t i = nanoseconds < 2 ? 0 : 63 - __builtin_clzll(nanoseconds);
+
+    this->buckets[i < HISTOGRAM_BUCKETS ? i : HISTOGRAM_BUCKETS - 1]++;
+}
+
+void
+Histogram::merge(
+    const Histogram & other)
+{
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        this->buckets[i] += other.buckets[i];
+    }
+}
+
+void
+Counters::merge(
+    const Counters & other)
+{
+    this->calls += other.calls;
+    this->hits += other.hits;
+    this->placements += other.placements;
+    this->eliminations += other.eliminations;
+    this->nanoseconds += other.nanoseconds;
+    this->latency.merge(other.latency);
+}
+
+void
+Report::add_eliminator(
+    const char * name)
+{
+    this->names.push_back(name);
+    this->puzzle.push_back(Counters());
+    this->batch.push_back(Counters());
+}
+
+void
+Report::begin_puzzle()
+{
+    for (auto & c: this->puzzle) {
+        c = Counters();
+    }
+}
+
+void
+Report::end_puzzle()
+{
+    for (size_t i = 0; i < this->puzzle.size(); i++) {
+        this->batch[i].merge(this->puzzle[i]);
+    }
+
+    this->puzzles++;
+}
+
+void
+Report::record(
+    size_t eliminator,
+    size_t placements,
+    size_t eliminations,
+    uint64_t nanoseconds)
+{
+    Counters & c = this->puzzle[eliminator];
+
+    c.calls++;
+    c.hits += (placements + eliminations) > 0;
+    c.placements += placements;
+    c.eliminations += eliminations;
+    c.nanoseconds += nanoseconds;
+    c.latency.add(nanoseconds);
+}
+
+void
+Report::merge(
+    const Report & other)
+{
+    while (this->names.size() < other.names.size()) {
+        add_eliminator(other.names[this->names.size()]);
+    }
+
+    for (size_t i = 0; i < other.batch.size(); i++) {
+        this->batch[i].merge(other.batch[i]);
+    }
+
+    this->puzzles += other.puzzles;
+}
+
+void
+Report::write_json(
+    std::ostream & os) const
+{
+    os << "{\"enabled\": " << (enabled ? "true" : "false")
+       << ", \"puzzles\": " << this->puzzles
+       << ", \"eliminators\": [";
+
+    for (size_t i = 0; i < this->names.size(); i++) {
+        os << (i > 0 ? ", " : "") << "{\"name\": \"" << this->names[i] << "\", \"puzzle\": ";
+        write_counters(os, this->puzzle[i]);
+        os << ", \"batch\": ";
+        write_counters(os, this->batch[i]);
+        os << "}";
+    }
+
+    os << "]}" << std::endl;
+}
@@ -0,0 +1,104 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <iosfwd>
+
+#include "sudoku.h"
+
+// Recording is compiled in with ./configure --enable-instrumentation.
+// Otherwise the SUDOKU_INSTRUMENT statements expand to nothing and a
+// Report stays empty.
+#if SUDOKU_INSTRUMENTATION
+#define SUDOKU_INSTRUMENT(...) __VA_ARGS__
+#else
+#define SUDOKU_INSTRUMENT(...)
+#endif
+
+namespace sudoku {
+    namespace instrument {
+        // True when the library was built with instrumentation.
+        extern const bool enabled;
+
+        const size_t HISTOGRAM_BUCKETS = 32;
+
+        // Latencies in power of two buckets, bucket i counts the ones in
+        // [2^i, 2^(i + 1)) nanoseconds and bucket 0 also the zeros.
+        struct Histogram
+        {
+            uint64_t buckets[HISTOGRAM_BUCKETS];
+
+            void add(uint64_t nanoseconds);
+            void merge(const Histogram & other);
+        };
+
+        struct Counters
+        {
+            uint64_t calls;
+            uint64_t hits;
+            uint64_t placements;
+            uint64_t eliminations;
+            uint64_t nanoseconds;
+            Histogram latency;
+
+            void merge(const Counters & other);
+        };
+
+        // Eliminator counters of the puzzle solved last and of all puzzles
+        // so far, indexed like eliminator::Profile.  One report can be
+        // shared by the solvers of a batch.
+        class Report
+        {
+        public:
+            Report() : puzzles(0) {}
+
+            void add_eliminator(const char * name);
+
+            void begin_puzzle();
+            void end_puzzle();
+
+            void record(size_t eliminator, size_t placements, size_t eliminations,
+                        uint64_t nanoseconds);
+
+            // Adds the batch totals of another report, e.g. one per thread.
+            void merge(const Report & other);
+
+            size_t get_puzzles() const {
+                return this->puzzles;
+            }
+
+            const std::vector<Counters> & get_puzzle() const {
+                return this->puzzle;
+            }
+
+            const std::vector<Counters> & get_batch() const {
+                return this->batch;
+            }
+
+            void write_json(std::ostream & os) const;
+
+        private:
+            std::vector<const char *> names;
+            std::vector<Counters> puzzle;
+            std::vector<Counters> batch;
+            size_t puzzles;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,232 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "mapped_file.h"
+
+using namespace sudoku;
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+bool
+MappedFile::open(
+    const std::string & path,
+    bool writable)
+{
+    int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    struct stat st;
+
+    unmap();
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        this->error = path + ": " + std::strerror(errno);
+
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    this->length = st.st_size;
+
+    bool ok = map(fd, writable ? PROT_READ | PROT_WRITE : PROT_READ);
+
+    ::close(fd);
+
+    if (ok) {
+        madvise(this->data, this->length, MADV_SEQUENTIAL);
+    } else {
+        this->error = path + ": " + this->error;
+    }
+
+    return ok;
+}
+
+bool
+MappedFile::create(
+    const std::string & path,
+    size_t length)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    unmap();
+
+    if (fd < 0 || ftruncate(fd, length) != 0) {
+        this->error = path + ": " + std::strerror(errno);
+
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    this->length = length;
+
+    bool ok = map(fd, PROT_READ | PROT_WRITE);
+
+    ::close(fd);
+
+    if (!ok) {
+        this->error = path + ": " + this->error;
+    }
+
+    return ok;
+}
+
+bool
+MappedFile::open_locked(
+    const std::string & path,
+    size_t length,
+    bool & created)
+{
+    // O_EXCL, so that of two processes creating the file only one
+    // initializes it.
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    struct stat st;
+
+    unmap();
+
+    created = fd >= 0;
+
+    if (fd < 0 && errno == EEXIST) {
+        fd = ::open(path.c_str(), O_RDWR);
+    }
+
+    if (fd < 0 || flock(fd, LOCK_EX | LOCK_NB) != 0
+        || (created && ftruncate(fd, length) != 0) || fstat(fd, &st) != 0) {
+        this->error = path + ": "
+            + (errno == EWOULDBLOCK ? "locked by another process" : std::strerror(errno));
+
+        if (fd >= 0) {
+            ::close(fd);
+        }
+
+        if (created) {
+            unlink(path.c_str());
+        }
+        return false;
+    }
+
+    this->length = st.st_size;
+
+    if (!map(fd, PROT_READ | PROT_WRITE)) {
+        this->error = path + ": " + this->error;
+        ::close(fd);
+        return false;
+    }
+
+    this->fd = fd;
+    return true;
+}
+
+bool
+MappedFile::map(
+    int fd,
+    int protection)
+{
+    // mmap() refuses empty mappings.
+    if (this->length == 0) {
+        return true;
+    }
+
+    void * p = mmap(nullptr, this->length, protection, MAP_SHARED, fd, 0);
+
+    if (p == MAP_FAILED) {
+        this->error = std::strerror(errno);
+        this->length = 0;
+        return false;
+    }
+
+    this->data = static_cast<char *>(p);
+    return true;
+}
+
+void
+MappedFile::unmap()
+{
+    if (this->data != nullptr) {
+        munmap(this->data, this->length);
+    }
+
+    if (this->fd >= 0) {
+        ::close(this->fd);
+    }
+
+    this->data = nullptr;
+    this->length = 0;
+    this->fd = -1;
+}
+
+bool
+sudoku::write_all(
+    int fd,
+    const char * data,
+    size_t length)
+{
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+bool
+sudoku::read_all(
+    int fd,
+    char * data,
+    size_t length,
+    uint64_t offset)
+{
+    while (length > 0) {
+        ssize_t n = pread(fd, data, length, offset);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+
+        data += n;
+        length -= n;
+        offset += n;
+    }
+
+    return true;
+}
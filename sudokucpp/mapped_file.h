@@ -0,0 +1,80 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sudoku {
+    // Read-only or read-write memory mapping of a whole file.
+    class MappedFile
+    {
+    public:
+        MappedFile() : data(nullptr), length(0), fd(-1) {}
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile & operator=(const MappedFile &) = delete;
+
+        // Maps an existing file for reading, and for writing if writable.
+        bool open(const std::string & path, bool writable = false);
+
+        // Creates or truncates a file of length bytes and maps it for writing.
+        bool create(const std::string & path, size_t length);
+
+        // Maps a file for writing, creating it with length bytes when it
+        // does not exist, and holds an exclusive flock() on it while
+        // mapped.  Fails when another process holds the lock.  created
+        // tells whether the file is new.
+        bool open_locked(const std::string & path, size_t length, bool & created);
+
+        char * get_data() const {
+            return this->data;
+        }
+
+        size_t size() const {
+            return this->length;
+        }
+
+        // The reason of the last failure.
+        const std::string & get_error() const {
+            return this->error;
+        }
+
+    private:
+        bool map(int fd, int protection);
+        void unmap();
+
+        char * data;
+        size_t length;
+        // Kept open for the lock of open_locked(), otherwise -1.
+        int fd;
+        std::string error;
+    };
+
+    // write() until all of data is written.  Returns false on an error,
+    // with errno set.
+    bool write_all(int fd, const char * data, size_t length);
+
+    // pread() until length bytes are read from offset.  Returns false on
+    // an error or at the end of the file.
+    bool read_all(int fd, char * data, size_t length, uint64_t offset);
+}
+
+#endif
@@ -0,0 +1,199 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+
+#include "config.h"
+#include "packed.h"
+
+using namespace sudoku;
+
+namespace {
+    const char MAGIC[4] = { 'S', 'D', 'K', 'P' };
+
+    const uint8_t INVALID = 0xf;
+
+    // Records unpacked at a time by solve_batch().
+    const size_t CHUNK = 64;
+
+    void
+    store(
+        uint8_t * p,
+        uint64_t value,
+        size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++) {
+            p[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint64_t
+    load(
+        const uint8_t * p,
+        size_t bytes)
+    {
+        uint64_t value = 0;
+
+        for (size_t i = bytes; i > 0; i--) {
+            value = (value << 8) | p[i - 1];
+        }
+
+        return value;
+    }
+}
+
+bool
+packed::pack(
+    const char * record,
+    uint8_t * out)
+{
+    uint8_t nibbles[PACKED_LENGTH * 2] = {};
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        char c = record[i];
+
+        if (c >= '1' && c <= '9') {
+            nibbles[i] = c - '0';
+        } else if (c != '0' && c != '.') {
+            std::memset(out, INVALID | (INVALID << 4), PACKED_LENGTH);
+            return false;
+        }
+    }
+
+    for (size_t k = 0; k < PACKED_LENGTH; k++) {
+        out[k] = nibbles[2 * k] | (nibbles[2 * k + 1] << 4);
+    }
+
+    return true;
+}
+
+void
+packed::unpack(
+    const uint8_t * in,
+    char * record)
+{
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        uint8_t n = (in[i / 2] >> (4 * (i % 2))) & 0xf;
+
+        if (n > SUDOKU_NUMBERS) {
+            std::memset(record, '?', RECORD_LENGTH);
+            return;
+        }
+
+        record[i] = '0' + n;
+    }
+}
+
+size_t
+packed::file_size(
+    uint64_t count)
+{
+    return HEADER_LENGTH + count * PACKED_LENGTH;
+}
+
+bool
+packed::is_packed(
+    const void * data,
+    size_t length)
+{
+    return length >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+packed::Reader::Reader(
+    const void * data,
+    size_t length)
+{
+    auto p = static_cast<const uint8_t *>(data);
+
+    if (length < HEADER_LENGTH || !is_packed(data, length)) {
+        throw std::invalid_argument("Not a packed puzzle file");
+    }
+
+    if (load(p + 4, 2) != FORMAT_VERSION || load(p + 6, 2) != PACKED_LENGTH) {
+        throw std::invalid_argument("Unsupported packed puzzle file version");
+    }
+
+    this->records = p + HEADER_LENGTH;
+    this->count = load(p + 8, 8);
+
+    if (this->count > (length - HEADER_LENGTH) / PACKED_LENGTH) {
+        throw std::invalid_argument("Truncated packed puzzle file");
+    }
+}
+
+void
+packed::Reader::get_batch(
+    size_t first,
+    size_t n,
+    char * records) const
+{
+    for (size_t i = 0; i < n; i++) {
+        get(first + i, records + i * RECORD_LENGTH);
+    }
+}
+
+packed::Writer::Writer(
+    void * data,
+    uint64_t count) : records(static_cast<uint8_t *>(data) + HEADER_LENGTH),
+                      count(count)
+{
+    auto p = static_cast<uint8_t *>(data);
+
+    std::memcpy(p, MAGIC, sizeof(MAGIC));
+    store(p + 4, FORMAT_VERSION, 2);
+    store(p + 6, PACKED_LENGTH, 2);
+    store(p + 8, count, 8);
+}
+
+size_t
+packed::Writer::set_batch(
+    size_t first,
+    size_t n,
+    const char * records)
+{
+    size_t invalid = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        invalid += !set(first + i, records + i * RECORD_LENGTH);
+    }
+
+    return invalid;
+}
+
+size_t
+packed::solve_batch(
+    BatchSolver & solver,
+    const Reader & in,
+    size_t first,
+    size_t n,
+    Writer & out,
+    Status * status)
+{
+    char records[CHUNK * RECORD_LENGTH];
+    size_t solved = 0;
+
+    for (size_t done = 0; done < n; ) {
+        size_t m = std::min(CHUNK, n - done);
+
+        in.get_batch(first + done, m, records);
+        solved += solver.solve_batch(records, m, records,
+                                     status != nullptr ? status + done : nullptr);
+        out.set_batch(first + done, m, records);
+        done += m;
+    }
+
+    return solved;
+}
@@ -0,0 +1,115 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef PACKED_H
+#define PACKED_H
+
+#include "batch.h"
+
+namespace sudoku {
+    // Binary puzzle files: a header followed by fixed-size records of
+    // one 4-bit nibble per cell, so that a file is less than half the
+    // size of the text and record i is at a known offset.
+    //
+    //  offset  size
+    //       0     4  magic "SDKP"
+    //       4     2  format version
+    //       6     2  record length in bytes
+    //       8     8  number of records
+    //
+    // Integers are little-endian.  Cell 2k is in the low nibble and
+    // cell 2k + 1 in the high nibble of byte k of a record; 0 is an
+    // unsolved cell.  Records of malformed puzzles have every nibble set
+    // and unpack to '?' characters.
+    namespace packed {
+        const size_t HEADER_LENGTH = 16;
+        const size_t PACKED_LENGTH = (SUDOKU_GRID_LENGTH + 1) / 2;
+        const uint16_t FORMAT_VERSION = 1;
+
+        // Packs a record in the format of parse_grid().  Returns false,
+        // and writes an invalid record, for anything else.
+        bool pack(const char * record, uint8_t * out);
+
+        // Writes RECORD_LENGTH characters, '0' for unsolved cells.
+        void unpack(const uint8_t * in, char * record);
+
+        // Size of a file of count records.
+        size_t file_size(uint64_t count);
+
+        // True when data starts with the magic of the format.
+        bool is_packed(const void * data, size_t length);
+
+        // Random access to the records of a file in memory, for example
+        // one mapped with mmap().
+        class Reader
+        {
+        public:
+            // Throws std::invalid_argument unless data holds a header of
+            // this version and all the records it counts.
+            Reader(const void * data, size_t length);
+
+            size_t size() const {
+                return this->count;
+            }
+
+            void get(size_t i, char * record) const {
+                unpack(this->records + i * PACKED_LENGTH, record);
+            }
+
+            // Unpacks records [first, first + n) one after another.
+            void get_batch(size_t first, size_t n, char * records) const;
+
+            const uint8_t * get_packed(size_t i) const {
+                return this->records + i * PACKED_LENGTH;
+            }
+
+        private:
+            const uint8_t * records;
+            uint64_t count;
+        };
+
+        // Fills a buffer of file_size(count) bytes.
+        class Writer
+        {
+        public:
+            Writer(void * data, uint64_t count);
+
+            size_t size() const {
+                return this->count;
+            }
+
+            bool set(size_t i, const char * record) {
+                return pack(record, this->records + i * PACKED_LENGTH);
+            }
+
+            // Packs n records to [first, first + n).  Returns the number
+            // of malformed ones.
+            size_t set_batch(size_t first, size_t n, const char * records);
+
+        private:
+            uint8_t * records;
+            uint64_t count;
+        };
+
+        // Solves records [first, first + n) of in to the same slots of
+        // out, which may share the buffer of in, as with
+        // BatchSolver::solve_batch().  Does not allocate.
+        size_t solve_batch(BatchSolver & solver, const Reader & in, size_t first,
+                           size_t n, Writer & out, Status * status);
+    }
+}
+
+#endif
@@ -0,0 +1,254 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+
+#include "config.h"
+#include "parallel.h"
+
+using namespace sudoku;
+
+namespace {
+    inline uint64_t
+    pack(uint32_t first, uint32_t last)
+    {
+        return (uint64_t(last) << 32) | first;
+    }
+
+    inline uint32_t
+    first_of(uint64_t range)
+    {
+        return static_cast<uint32_t>(range);
+    }
+
+    inline uint32_t
+    last_of(uint64_t range)
+    {
+        return static_cast<uint32_t>(range >> 32);
+    }
+}
+
+ParallelBatchSolver::ParallelBatchSolver(
+    Backend backend,
+    size_t threads) : generation(0), running(0), stopping(false),
+                      in(nullptr), out(nullptr), status(nullptr), solved(0)
+{
+    if (threads == 0) {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    // Constructing the solvers first, as that throws for Backend::Logic.
+    for (size_t i = 0; i < threads; i++) {
+        this->workers.push_back(std::unique_ptr<Worker>(new Worker(backend)));
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        this->workers[i]->thread = std::thread(&ParallelBatchSolver::run, this, i);
+    }
+}
+
+ParallelBatchSolver::~ParallelBatchSolver()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+
+    this->started.notify_all();
+
+    for (auto & w: this->workers) {
+        w->thread.join();
+    }
+}
+
+void
+ParallelBatchSolver::set_step_budget(
+    size_t steps)
+{
+    for (auto & w: this->workers) {
+        w->solver.get_limits().set_step_budget(steps);
+    }
+}
+
+void
+ParallelBatchSolver::set_deadline(
+    Limits::clock_t::time_point deadline)
+{
+    for (auto & w: this->workers) {
+        w->solver.get_limits().set_deadline(deadline);
+    }
+}
+
+void
+ParallelBatchSolver::set_cancellation_token(
+    std::shared_ptr<CancellationToken> token)
+{
+    for (auto & w: this->workers) {
+        w->solver.get_limits().set_cancellation_token(token);
+    }
+}
+
+void
+ParallelBatchSolver::set_cache(
+    std::shared_ptr<SolutionCache> cache)
+{
+    for (auto & w: this->workers) {
+        w->solver.set_cache(cache);
+    }
+}
+
+void
+ParallelBatchSolver::set_store(
+    std::shared_ptr<SolutionStore> store)
+{
+    for (auto & w: this->workers) {
+        w->solver.set_store(store);
+    }
+}
+
+size_t
+ParallelBatchSolver::solve_batch(
+    const char * in,
+    size_t n,
+    char * out,
+    Status * status)
+{
+    SUDOKU_TRACE("ParallelBatchSolver::solve_batch");
+
+    if (n > UINT32_MAX) {
+        throw std::invalid_argument("Too many records in a batch");
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t threads = this->workers.size();
+
+    this->in = in;
+    this->out = out;
+    this->status = status;
+    this->solved = 0;
+
+    for (size_t i = 0; i < threads; i++) {
+        this->workers[i]->range.store(pack(n * i / threads, n * (i + 1) / threads),
+                                      std::memory_order_relaxed);
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->running = threads;
+    this->generation++;
+    this->started.notify_all();
+    this->finished.wait(lock, [this]() { return this->running == 0; });
+
+    return this->solved;
+}
+
+void
+ParallelBatchSolver::run(
+    size_t self)
+{
+    Worker & w = *this->workers[self];
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            this->started.wait(lock, [this, seen]() {
+                return this->stopping || this->generation != seen;
+            });
+
+            if (this->stopping) {
+                return;
+            }
+
+            seen = this->generation;
+        }
+
+        size_t count = 0;
+        uint32_t r;
+
+        while (take(self, r) || steal(self, r)) {
+            auto st = w.solver.solve(this->in + r * RECORD_LENGTH,
+                                     this->out + r * RECORD_LENGTH);
+
+            if (this->status != nullptr) {
+                this->status[r] = st;
+            }
+
+            count += st == Status::Solved;
+        }
+
+        this->solved += count;
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (--this->running == 0) {
+            this->finished.notify_one();
+        }
+    }
+}
+
+bool
+ParallelBatchSolver::take(
+    size_t self,
+    uint32_t & record)
+{
+    auto & range = this->workers[self]->range;
+    uint64_t v = range.load(std::memory_order_acquire);
+
+    while (first_of(v) < last_of(v)) {
+        if (range.compare_exchange_weak(v, pack(first_of(v) + 1, last_of(v)),
+                                        std::memory_order_acq_rel)) {
+            record = first_of(v);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+ParallelBatchSolver::steal(
+    size_t self,
+    uint32_t & record)
+{
+    size_t threads = this->workers.size();
+
+    for (size_t k = 1; k < threads; k++) {
+        auto & victim = this->workers[(self + k) % threads]->range;
+        uint64_t v = victim.load(std::memory_order_acquire);
+
+        while (first_of(v) < last_of(v)) {
+            uint32_t first = first_of(v);
+            uint32_t last = last_of(v);
+            // The back half, rounded up so that the last record goes too.
+            uint32_t mid = last - (last - first + 1) / 2;
+
+            if (victim.compare_exchange_weak(v, pack(first, mid),
+                                             std::memory_order_acq_rel)) {
+                record = mid;
+                this->workers[self]->range.store(pack(mid + 1, last),
+                                                 std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
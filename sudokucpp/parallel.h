@@ -0,0 +1,96 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "batch.h"
+
+namespace sudoku {
+    // Solves batches on a pool of threads, each with its own BatchSolver.
+    // Every thread starts with an equal share of the records and, once
+    // done with it, steals half of the remaining records of another
+    // thread, so that a few hard puzzles do not leave the other threads
+    // idle.  Results go to the slots of their records, so the output does
+    // not depend on the scheduling.
+    class ParallelBatchSolver
+    {
+    public:
+        // 0 threads for one per hardware thread.
+        explicit ParallelBatchSolver(Backend backend = Backend::Bitboard,
+                                     size_t threads = 0);
+        ~ParallelBatchSolver();
+
+        ParallelBatchSolver(const ParallelBatchSolver &) = delete;
+        ParallelBatchSolver & operator=(const ParallelBatchSolver &) = delete;
+
+        size_t get_threads() const {
+            return this->workers.size();
+        }
+
+        // Limits for the following batches, as with BatchSolver.
+        void set_step_budget(size_t steps);
+        void set_deadline(Limits::clock_t::time_point deadline);
+        void set_cancellation_token(std::shared_ptr<CancellationToken> token);
+
+        // One cache and store for all the threads.
+        void set_cache(std::shared_ptr<SolutionCache> cache);
+        void set_store(std::shared_ptr<SolutionStore> store);
+
+        // Like BatchSolver::solve_batch().  One batch at a time.
+        size_t solve_batch(const char * in, size_t n, char * out, Status * status);
+
+    private:
+        // Remaining records [first, last) of a worker in one word, so
+        // that the owner taking from the front and thieves splitting off
+        // the back agree with a single compare-and-swap.
+        struct Worker {
+            std::atomic<uint64_t> range;
+            // Keeps the limits the owner updates on every search step
+            // off the cache line thieves read.
+            char padding[64];
+            BatchSolver solver;
+            std::thread thread;
+
+            explicit Worker(Backend backend) : range(0), solver(backend) {}
+        };
+
+        void run(size_t self);
+        bool take(size_t self, uint32_t & record);
+        bool steal(size_t self, uint32_t & record);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+
+        std::mutex mutex;
+        std::condition_variable started;
+        std::condition_variable finished;
+        uint64_t generation;
+        size_t running;
+        bool stopping;
+
+        const char * in;
+        char * out;
+        Status * status;
+        std::atomic<size_t> solved;
+    };
+}
+
+#endif
@@ -17,8 +17,12 @@
 #ifndef PERMUTATIONS_H
 #define PERMUTATIONS_H
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <experimental/optional>
+#include <stdexcept>
 #include <vector>
 
 namespace sudoku {
@@ -101,6 +105,178 @@ namespace sudoku {
                 return this->visit();
             }
         };
+
+        const size_t MAX_LENGTH = 16;
+
+        // Lexicographic rank of a permutation, 0 ... length! - 1.
+        typedef uint64_t rank_t;
+
+        constexpr rank_t factorial(size_t n) {
+            rank_t f = 1;
+
+            for (size_t i = 2; i <= n; i++) {
+                f *= i;
+            }
+            return f;
+        }
+
+        // Permutation of {0, ..., length - 1}, length <= MAX_LENGTH, kept
+        // in a fixed array and stepped in place.  Throws
+        // std::invalid_argument for a longer one.
+        //
+        //     FixedPermutation p(9);
+        //     do { ... p[i] ... } while (p.next());
+        struct FixedPermutation {
+            std::array<uint8_t, MAX_LENGTH> items;
+            size_t length;
+
+            explicit FixedPermutation(size_t length) : length(length) {
+                if (length > MAX_LENGTH) {
+                    throw std::invalid_argument("Too many elements for a permutation");
+                }
+
+                for (size_t i = 0; i < MAX_LENGTH; i++) {
+                    this->items[i] = i;
+                }
+            }
+
+            size_t size() const {
+                return this->length;
+            }
+
+            uint8_t operator[](size_t i) const {
+                return this->items[i];
+            }
+
+            const uint8_t * begin() const {
+                return this->items.data();
+            }
+
+            const uint8_t * end() const {
+                return this->items.data() + this->length;
+            }
+
+            bool operator==(const FixedPermutation & other) const {
+                return this->length == other.length
+                    && std::equal(this->begin(), this->end(), other.begin());
+            }
+
+            bool operator!=(const FixedPermutation & other) const {
+                return !(*this == other);
+            }
+
+            // Steps to the lexicographic successor.  After the last
+            // permutation returns false and starts over from the identity.
+            bool next() {
+                auto first = this->items.begin();
+                auto last = first + this->length;
+
+                if (this->length < 2) {
+                    return false;
+                }
+
+                auto i = last - 2;
+
+                while (*i >= *(i + 1)) {
+                    if (i == first) {
+                        std::reverse(first, last);
+                        return false;
+                    }
+                    i--;
+                }
+
+                auto j = last - 1;
+
+                while (*j <= *i) {
+                    j--;
+                }
+
+                std::iter_swap(i, j);
+                std::reverse(i + 1, last);
+
+                return true;
+            }
+
+            // The position of set bit d, counting from 0, of a mask of
+            // MAX_LENGTH bits: a popcount of the low half for each halving.
+            static uint8_t select(uint32_t mask, uint32_t d) {
+                uint8_t position = 0;
+
+                for (size_t width = MAX_LENGTH / 2; width > 0; width /= 2) {
+                    uint32_t low = mask & ((uint32_t(1) << width) - 1);
+                    uint32_t n = __builtin_popcount(low);
+
+                    if (d < n) {
+                        mask = low;
+                    } else {
+                        d -= n;
+                        mask >>= width;
+                        position += width;
+                    }
+                }
+
+                return position;
+            }
+
+            // The popcounts of the elements before each one give the
+            // digits of the rank in the factorial number system, which
+            // Horner's rule sums up.
+            rank_t rank() const {
+                uint32_t used = 0;
+                rank_t r = 0;
+
+                for (size_t i = 0; i < this->length; i++) {
+                    uint32_t a = this->items[i];
+                    uint32_t smaller = ~used & ((uint32_t(1) << a) - 1);
+
+                    r = r * (this->length - i) + __builtin_popcount(smaller);
+                    used |= uint32_t(1) << a;
+                }
+
+                return r;
+            }
+
+            static FixedPermutation unrank(size_t length, rank_t r) {
+                FixedPermutation p(length);
+                uint8_t digits[MAX_LENGTH];
+                uint32_t unused = (uint32_t(1) << length) - 1;
+
+                for (size_t i = length; i > 0; i--) {
+                    size_t radix = length - i + 1;
+
+                    digits[i - 1] = r % radix;
+                    r /= radix;
+                }
+
+                for (size_t i = 0; i < length; i++) {
+                    p.items[i] = select(unused, digits[i]);
+                    unused &= ~(uint32_t(1) << p.items[i]);
+                }
+
+                return p;
+            }
+
+            FixedPermutation inverse() const {
+                FixedPermutation p(this->length);
+
+                for (size_t i = 0; i < this->length; i++) {
+                    p.items[this->items[i]] = i;
+                }
+
+                return p;
+            }
+        };
+
+        // Calls f(const FixedPermutation &) for every permutation of
+        // length elements in lexicographic order.
+        template <typename F>
+        void for_each(size_t length, F f) {
+            FixedPermutation p(length);
+
+            do {
+                f(static_cast<const FixedPermutation &>(p));
+            } while (p.next());
+        }
     }
 }
 
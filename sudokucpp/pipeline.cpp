@@ -0,0 +1,320 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "mapped_file.h"
+#include "pipeline.h"
+#include "queue.h"
+
+using namespace sudoku;
+
+namespace {
+    const size_t LINE_LENGTH = RECORD_LENGTH + 1;
+    const size_t READ_SIZE = 1 << 20;
+
+    struct Block {
+        size_t sequence;
+        size_t records;
+        std::vector<char> in;
+        std::vector<char> out;
+        std::vector<Status> status;
+    };
+
+    // Collects lines that may be split between reads into the records
+    // of a block.
+    class LineReader
+    {
+    public:
+        LineReader() : length(0), overlong(false) {}
+
+        // Appends the bytes of a line up to, but not including, a newline.
+        void append(const char * p, size_t n) {
+            if (this->length + n > RECORD_LENGTH + 1) {
+                this->overlong = true;
+                return;
+            }
+
+            std::memcpy(this->line + this->length, p, n);
+            this->length += n;
+        }
+
+        bool empty() const {
+            return this->length == 0 && !this->overlong;
+        }
+
+        // Writes the line as a record and starts the next one.
+        void finish(char * record) {
+            size_t n = this->length;
+
+            if (n > 0 && this->line[n - 1] == '\r') {
+                n--;
+            }
+
+            if (n == RECORD_LENGTH && !this->overlong) {
+                std::memcpy(record, this->line, RECORD_LENGTH);
+            } else {
+                std::memset(record, '?', RECORD_LENGTH);
+            }
+
+            this->length = 0;
+            this->overlong = false;
+        }
+
+    private:
+        char line[RECORD_LENGTH + 2];
+        size_t length;
+        bool overlong;
+    };
+
+    size_t
+    power_of_two(size_t n)
+    {
+        size_t p = 2;
+
+        while (p < n) {
+            p *= 2;
+        }
+        return p;
+    }
+}
+
+Pipeline::Pipeline(
+    Backend backend,
+    size_t threads,
+    size_t block_records) : backend(backend), threads(threads),
+                            block_records(std::max<size_t>(1, block_records)), steps(0)
+{
+    if (this->threads == 0) {
+        this->threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    std::fill(std::begin(this->counts), std::end(this->counts), 0);
+
+    // Fails early for Backend::Logic.
+    BatchSolver check(backend);
+}
+
+bool
+Pipeline::run(
+    int in,
+    int out)
+{
+    SUDOKU_TRACE("Pipeline::run");
+
+    // Enough blocks to keep every solver busy while the reader fills and
+    // the writer drains some more.
+    const size_t nblocks = 2 * this->threads + 2;
+    const size_t capacity = power_of_two(nblocks + this->threads);
+
+    std::vector<Block> blocks(nblocks);
+    queue::BoundedQueue<Block *> free(capacity);
+    queue::BoundedQueue<Block *> work(capacity);
+    queue::BoundedQueue<Block *> done(capacity);
+
+    for (auto & b: blocks) {
+        b.in.resize(this->block_records * RECORD_LENGTH);
+        b.out.resize(this->block_records * LINE_LENGTH);
+        b.status.resize(this->block_records);
+        free.push(&b);
+    }
+
+    std::fill(std::begin(this->counts), std::end(this->counts), 0);
+
+    std::atomic<size_t> total(SIZE_MAX);
+    std::atomic<bool> failed(false);
+    int read_errno = 0;
+    int write_errno = 0;
+
+    // A failed write wakes the reader from waiting for input, which may
+    // not end for a long time, through this pipe.
+    int stop[2];
+
+    if (pipe(stop) != 0) {
+        return false;
+    }
+
+    std::thread reader([&]() {
+        std::vector<char> buffer(READ_SIZE);
+        pollfd fds[] = { { in, POLLIN, 0 }, { stop[0], POLLIN, 0 } };
+        LineReader line;
+        Block * block = free.pop();
+        size_t sequence = 0;
+
+        block->records = 0;
+
+        auto flush = [&]() {
+            block->sequence = sequence++;
+            work.push(block);
+            block = free.pop();
+            block->records = 0;
+        };
+
+        while (!failed) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                read_errno = errno;
+                failed = true;
+                break;
+            }
+
+            if (fds[1].revents != 0) {
+                break;
+            }
+
+            ssize_t n = read(in, buffer.data(), buffer.size());
+
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (n < 0) {
+                read_errno = errno;
+                failed = true;
+                break;
+            }
+
+            if (n == 0) {
+                break;
+            }
+
+            const char * p = buffer.data();
+            const char * end = p + n;
+
+            while (p < end) {
+                auto eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+
+                line.append(p, (eol != nullptr ? eol : end) - p);
+
+                if (eol == nullptr) {
+                    break;
+                }
+
+                line.finish(&block->in[block->records++ * RECORD_LENGTH]);
+
+                if (block->records == this->block_records) {
+                    flush();
+                }
+
+                p = eol + 1;
+            }
+        }
+
+        if (!line.empty()) {
+            line.finish(&block->in[block->records++ * RECORD_LENGTH]);
+        }
+
+        if (block->records > 0) {
+            flush();
+        }
+
+        free.push(block);
+        total = sequence;
+
+        for (size_t i = 0; i < this->threads; i++) {
+            work.push(nullptr);
+        }
+    });
+
+    std::vector<std::thread> solvers;
+
+    for (size_t t = 0; t < this->threads; t++) {
+        solvers.push_back(std::thread([&]() {
+            BatchSolver solver(this->backend);
+
+            solver.get_limits().set_step_budget(this->steps);
+            solver.set_cache(this->cache);
+            solver.set_store(this->store);
+
+            while (Block * b = work.pop()) {
+                for (size_t i = 0; i < b->records; i++) {
+                    char * line = &b->out[i * LINE_LENGTH];
+
+                    b->status[i] = solver.solve(&b->in[i * RECORD_LENGTH], line);
+                    line[RECORD_LENGTH] = '\n';
+                }
+
+                done.push(b);
+            }
+        }));
+    }
+
+    // The writer runs on this thread.  Blocks finish out of order, but
+    // at most nblocks are in flight, so they can wait in a window
+    // indexed by their sequence number.
+    std::vector<Block *> window(nblocks, nullptr);
+    size_t next = 0;
+    queue::Backoff backoff;
+
+    while (next != total) {
+        Block * b;
+
+        if (!done.try_pop(b)) {
+            backoff.pause();
+            continue;
+        }
+
+        backoff = queue::Backoff();
+        window[b->sequence % nblocks] = b;
+
+        while ((b = window[next % nblocks]) != nullptr && b->sequence == next) {
+            window[next % nblocks] = nullptr;
+
+            if (!failed && !write_all(out, b->out.data(), b->records * LINE_LENGTH)) {
+                char c = 0;
+
+                write_errno = errno;
+                failed = true;
+
+                ssize_t n = write(stop[1], &c, 1);
+                (void) n;
+            }
+
+            for (size_t i = 0; i < b->records; i++) {
+                this->counts[static_cast<size_t>(b->status[i])]++;
+            }
+
+            free.push(b);
+            next++;
+        }
+    }
+
+    reader.join();
+
+    for (auto & t: solvers) {
+        t.join();
+    }
+
+    close(stop[0]);
+    close(stop[1]);
+
+    if (read_errno != 0 || write_errno != 0) {
+        errno = read_errno != 0 ? read_errno : write_errno;
+        return false;
+    }
+
+    return true;
+}
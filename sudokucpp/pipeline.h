@@ -0,0 +1,72 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "batch.h"
+
+namespace sudoku {
+    // Streams puzzles, one per line, from a file descriptor to another:
+    // a reader thread packs lines into blocks, solver threads solve the
+    // blocks and a writer thread writes them out in input order.  The
+    // stages pass blocks through bounded lock-free queues and a fixed
+    // pool of blocks is recycled, so memory stays constant whatever the
+    // size of the input.
+    //
+    // Each line comes out as RECORD_LENGTH characters and a newline: the
+    // solution, the puzzle when it is not solved, or '?' characters
+    // when the line is not a puzzle.
+    class Pipeline
+    {
+    public:
+        // 0 threads for one solver per hardware thread.
+        explicit Pipeline(Backend backend = Backend::Bitboard, size_t threads = 0,
+                          size_t block_records = 256);
+
+        void set_step_budget(size_t steps) {
+            this->steps = steps;
+        }
+
+        // Shared by the solver threads.
+        void set_cache(std::shared_ptr<SolutionCache> cache) {
+            this->cache = cache;
+        }
+
+        void set_store(std::shared_ptr<SolutionStore> store) {
+            this->store = store;
+        }
+
+        // Returns false on a read or write error, with errno set.
+        bool run(int in, int out);
+
+        // Records with the given status in the last run().
+        size_t get_count(Status status) const {
+            return this->counts[static_cast<size_t>(status)];
+        }
+
+    private:
+        Backend backend;
+        size_t threads;
+        size_t block_records;
+        size_t steps;
+        std::shared_ptr<SolutionCache> cache;
+        std::shared_ptr<SolutionStore> store;
+        size_t counts[static_cast<size_t>(Status::Invalid) + 1];
+    };
+}
+
+#endif
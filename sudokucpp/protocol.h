@@ -0,0 +1,89 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "packed.h"
+
+namespace sudoku {
+    // The protocol of Server and Client over a Unix domain socket.
+    // Every message is a header followed by a body:
+    //
+    //  offset  size
+    //       0     4  request id, copied to the response
+    //       4     1  type
+    //       5     1  result, 0 in requests
+    //       6     2  number of puzzles
+    //
+    // A Solve request carries count puzzles of PACKED_LENGTH bytes in
+    // the format of packed::pack(), and its response count records of
+    // a status byte and the packed solution, or the puzzle when it is
+    // not solved.  A Metrics request has no body and its response a
+    // Metrics.  Integers use the native byte order.
+    //
+    // Clients may send any number of requests before reading the
+    // responses, which come in the order they complete and are matched
+    // by their ids.  A malformed request gets a BadRequest response and
+    // the connection is then closed.
+    namespace protocol {
+        enum class Type : uint8_t {
+            Solve = 1,
+            Metrics = 2
+        };
+
+        enum class Result : uint8_t {
+            Ok = 0,
+            BadRequest = 1
+        };
+
+        struct Header {
+            uint32_t id;
+            Type type;
+            Result result;
+            uint16_t count;
+        };
+
+        static_assert(sizeof(Header) == 8, "Header must be packed");
+
+        const size_t MAX_COUNT = 4096;
+        const size_t SOLUTION_LENGTH = 1 + packed::PACKED_LENGTH;
+
+        // Counters since the server started.  Latencies are from reading
+        // a request to queueing its response, in nanoseconds, and are
+        // upper bounds that are at most 25% over the actual ones.
+        struct Metrics {
+            uint64_t uptime;
+            uint64_t threads;
+            uint64_t connections;
+            uint64_t requests;
+            uint64_t batches;
+            uint64_t puzzles;
+            uint64_t solved;
+            // Over the last ten seconds.
+            uint64_t puzzles_per_second;
+            // Puzzles read but not yet taken by a solver thread.
+            uint64_t queue_depth;
+            uint64_t latency_p50;
+            uint64_t latency_p90;
+            uint64_t latency_p99;
+            uint64_t latency_p999;
+            uint64_t latency_max;
+        };
+    }
+}
+
+#endif
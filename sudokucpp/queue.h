@@ -0,0 +1,151 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace sudoku {
+    namespace queue {
+        // Waits with yields first and then with short sleeps, so that an
+        // idle stage of a pipeline does not keep a core busy.
+        class Backoff
+        {
+        public:
+            Backoff() : count(0) {}
+
+            void pause() {
+                if (++this->count < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+
+        private:
+            size_t count;
+        };
+
+        // Bounded lock-free multi-producer multi-consumer queue after
+        // Dmitry Vyukov: every slot carries a sequence number that tells
+        // whether it is free for the producer or full for the consumer of
+        // a given position.  The slots are allocated once.
+        template <typename T>
+        class BoundedQueue
+        {
+        public:
+            // capacity must be a power of two.
+            explicit BoundedQueue(size_t capacity)
+                : slots(capacity), mask(capacity - 1), head(0), tail(0) {
+                if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+                    throw std::invalid_argument("Queue capacity must be a power of two");
+                }
+
+                for (size_t i = 0; i < capacity; i++) {
+                    this->slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            BoundedQueue(const BoundedQueue &) = delete;
+            BoundedQueue & operator=(const BoundedQueue &) = delete;
+
+            bool try_push(const T & value) {
+                size_t pos = this->tail.load(std::memory_order_relaxed);
+
+                while (true) {
+                    Slot & s = this->slots[pos & this->mask];
+                    size_t seq = s.sequence.load(std::memory_order_acquire);
+                    ssize_t diff = static_cast<ssize_t>(seq) - static_cast<ssize_t>(pos);
+
+                    if (diff == 0) {
+                        if (this->tail.compare_exchange_weak(pos, pos + 1,
+                                                             std::memory_order_relaxed)) {
+                            s.value = value;
+                            s.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = this->tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool try_pop(T & value) {
+                size_t pos = this->head.load(std::memory_order_relaxed);
+
+                while (true) {
+                    Slot & s = this->slots[pos & this->mask];
+                    size_t seq = s.sequence.load(std::memory_order_acquire);
+                    ssize_t diff = static_cast<ssize_t>(seq) - static_cast<ssize_t>(pos + 1);
+
+                    if (diff == 0) {
+                        if (this->head.compare_exchange_weak(pos, pos + 1,
+                                                             std::memory_order_relaxed)) {
+                            value = s.value;
+                            s.sequence.store(pos + this->mask + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = this->head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            void push(const T & value) {
+                Backoff backoff;
+
+                while (!try_push(value)) {
+                    backoff.pause();
+                }
+            }
+
+            T pop() {
+                Backoff backoff;
+                T value;
+
+                while (!try_pop(value)) {
+                    backoff.pause();
+                }
+                return value;
+            }
+
+        private:
+            struct Slot {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            std::vector<Slot> slots;
+            size_t mask;
+            // Producers and consumers on separate cache lines.
+            char padding0[64];
+            std::atomic<size_t> head;
+            char padding1[64];
+            std::atomic<size_t> tail;
+        };
+    }
+}
+
+#endif
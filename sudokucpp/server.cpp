@@ -0,0 +1,813 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "server.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace sudoku;
+using namespace sudoku::protocol;
+
+namespace {
+    const size_t READ_SIZE = 1 << 16;
+
+    // A connection is not read while this much of its output is unsent,
+    // so that a client that does not read its responses is held back.
+    const size_t MAX_UNSENT = 1 << 20;
+
+    const size_t HISTORY = 10;
+
+    size_t
+    power_of_two(size_t n)
+    {
+        size_t p = 2;
+
+        while (p < n) {
+            p *= 2;
+        }
+        return p;
+    }
+
+    // Four buckets per power of two: a bucket spans a quarter of the
+    // smallest value in it.
+    size_t
+    latency_bucket(uint64_t ns)
+    {
+        if (ns < 4) {
+            return ns;
+        }
+
+        size_t e = 63 - __builtin_clzll(ns);
+
+        return 4 * (e - 1) + ((ns >> (e - 2)) & 3);
+    }
+
+    // The largest value in a bucket.
+    uint64_t
+    latency_bound(size_t bucket)
+    {
+        if (bucket < 4) {
+            return bucket;
+        }
+
+        size_t e = bucket / 4 + 1;
+
+        return ((uint64_t(4 + bucket % 4) + 1) << (e - 2)) - 1;
+    }
+
+    void
+    set_flags(int fd)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+    }
+}
+
+struct Server::Connection {
+    int fd;
+    // Read but not yet parsed.
+    std::vector<char> input;
+    // No more reads, after the end of the input or a bad request; the
+    // connection is closed once its responses are sent.
+    bool closing;
+    // Requests being solved.
+    std::atomic<size_t> active;
+    // A request at the start of input whose puzzles did not all fit in
+    // the free batches.  Parsing resumes with it.
+    std::shared_ptr<Request> pending;
+
+    // Responses not yet sent, from the solver threads.
+    std::mutex mutex;
+    std::vector<char> output;
+    size_t sent;
+
+    explicit Connection(int fd) : fd(fd), closing(false), active(0), sent(0) {}
+
+    size_t unsent() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        return this->output.size() - this->sent;
+    }
+};
+
+struct Server::Request {
+    std::shared_ptr<Connection> connection;
+    clock_t::time_point received;
+    std::vector<char> response;
+    size_t count;
+    // Puzzles in batches so far.
+    size_t enqueued;
+    std::atomic<size_t> remaining;
+};
+
+struct Server::Batch {
+    // Puzzles [first, first + n) of a request at records [position,
+    // position + n) of the batch.
+    struct Slice {
+        std::shared_ptr<Request> request;
+        size_t first;
+        size_t position;
+        size_t n;
+    };
+
+    size_t records;
+    std::vector<char> in;
+    std::vector<char> out;
+    std::vector<Status> status;
+    std::vector<Slice> slices;
+};
+
+Server::Server(
+    Backend backend,
+    size_t threads,
+    size_t batch_records) : backend(backend), threads(threads),
+                            batch_records(std::max<size_t>(1, batch_records)),
+                            steps(0), linger(200), listener(-1), stopping(false),
+                            current(nullptr), connected(0), idle(0), requests(0),
+                            queued(0), puzzles(0), solved(0), batches_solved(0),
+                            latency_max(0)
+{
+    if (this->threads == 0) {
+        this->threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    this->waker[0] = -1;
+    this->waker[1] = -1;
+    this->start = clock_t::now();
+    std::memset(this->seconds, 0, sizeof(this->seconds));
+    std::memset(this->latencies, 0, sizeof(this->latencies));
+
+    // Fails early for Backend::Logic.
+    BatchSolver check(backend);
+}
+
+Server::~Server()
+{
+    for (int fd: { this->listener, this->waker[0], this->waker[1] }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    if (this->listener >= 0) {
+        unlink(this->path.c_str());
+    }
+}
+
+bool
+Server::listen(
+    const std::string & path)
+{
+    sockaddr_un address;
+
+    if (path.size() >= sizeof(address.sun_path)) {
+        this->error = path + ": Path too long";
+        return false;
+    }
+
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+
+    // Only a socket is replaced, not a file given by mistake.
+    struct stat st;
+
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+
+    if (pipe(this->waker) != 0) {
+        this->error = std::strerror(errno);
+        return false;
+    }
+
+    set_flags(this->waker[0]);
+    set_flags(this->waker[1]);
+
+    this->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (this->listener < 0
+        || bind(this->listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || ::listen(this->listener, SOMAXCONN) != 0) {
+        this->error = path + ": " + std::strerror(errno);
+
+        if (this->listener >= 0) {
+            close(this->listener);
+            this->listener = -1;
+        }
+        return false;
+    }
+
+    set_flags(this->listener);
+    this->path = path;
+
+    return true;
+}
+
+void
+Server::stop()
+{
+    this->stopping = true;
+    wake();
+}
+
+void
+Server::wake()
+{
+    char c = 0;
+    ssize_t n = write(this->waker[1], &c, 1);
+
+    // A full pipe wakes the poll() just as well.
+    (void) n;
+}
+
+bool
+Server::run()
+{
+    SUDOKU_TRACE("Server::run");
+
+    // Enough batches to keep every solver busy while more are filled.
+    const size_t nbatches = 2 * this->threads + 2;
+    const size_t capacity = power_of_two(nbatches);
+
+    this->batches.clear();
+    this->free.reset(new queue::BoundedQueue<Batch *>(capacity));
+
+    for (size_t i = 0; i < nbatches; i++) {
+        this->batches.emplace_back(new Batch());
+
+        Batch & b = *this->batches.back();
+
+        b.records = 0;
+        b.in.resize(this->batch_records * RECORD_LENGTH);
+        b.out.resize(this->batch_records * RECORD_LENGTH);
+        b.status.resize(this->batch_records);
+        this->free->push(&b);
+    }
+
+    this->current = nullptr;
+
+    for (size_t t = 0; t < this->threads; t++) {
+        this->solvers.push_back(std::thread(&Server::solve, this));
+    }
+
+    std::vector<pollfd> fds;
+    bool ok = true;
+
+    while (!this->stopping) {
+        // Reads stop while every batch is in use; a solver thread that
+        // returns one wakes the poll().
+        bool reading = this->current != nullptr || this->free->try_pop(this->current);
+
+        if (reading) {
+            for (auto & c: this->connections) {
+                if (c->pending) {
+                    parse(c);
+                }
+            }
+        }
+
+        fds.clear();
+        fds.push_back({ this->waker[0], POLLIN, 0 });
+        fds.push_back({ this->listener, static_cast<short>(reading ? POLLIN : 0), 0 });
+
+        for (auto & c: this->connections) {
+            size_t unsent = c->unsent();
+            short events = 0;
+
+            if (reading && !c->closing && !c->pending && unsent < MAX_UNSENT) {
+                events |= POLLIN;
+            }
+
+            if (unsent > 0) {
+                events |= POLLOUT;
+            }
+
+            fds.push_back({ c->fd, events, 0 });
+        }
+
+        timespec timeout;
+        timespec * wait = nullptr;
+
+        if (this->current != nullptr && this->current->records > 0) {
+            auto left = std::max(clock_t::duration::zero(),
+                                 this->started + this->linger - clock_t::now());
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+
+            timeout.tv_sec = ns / 1000000000;
+            timeout.tv_nsec = ns % 1000000000;
+            wait = &timeout;
+        }
+
+        if (ppoll(fds.data(), fds.size(), wait, nullptr) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            this->error = std::strerror(errno);
+            ok = false;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char buffer[64];
+
+            while (read(this->waker[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+
+        // Connections accepted now are polled from the next round on.
+        size_t polled = fds.size() - 2;
+
+        if (fds[1].revents & POLLIN) {
+            accept();
+        }
+
+        for (size_t i = 0; i < polled; i++) {
+            auto & c = this->connections[i];
+            bool alive = true;
+
+            // A hangup after the end of the input means that nobody
+            // waits for the rest of the responses.
+            if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+                alive = !c->closing && receive(c);
+            }
+
+            alive = alive && send(*c);
+
+            if (!alive || (c->closing && c->active == 0 && c->unsent() == 0)) {
+                close(c->fd);
+                c->fd = -1;
+                this->connected--;
+
+                // The puzzles of a waiting request that are not in a
+                // batch yet are dropped with it.
+                if (c->pending) {
+                    this->queued -= c->pending->count - c->pending->enqueued;
+                    c->pending.reset();
+                }
+            }
+        }
+
+        this->connections.erase(std::remove_if(this->connections.begin(),
+                                               this->connections.end(),
+                                               [](const std::shared_ptr<Connection> & c) {
+                                                   return c->fd < 0;
+                                               }),
+                                this->connections.end());
+
+        // Puzzles wait for more only while every solver thread is busy.
+        if (this->current != nullptr && this->current->records > 0
+            && (this->idle > 0 || clock_t::now() >= this->started + this->linger)) {
+            flush();
+        }
+    }
+
+    if (this->current != nullptr && this->current->records > 0) {
+        flush();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->work_mutex);
+
+        this->work.insert(this->work.end(), this->threads, nullptr);
+    }
+
+    this->work_ready.notify_all();
+
+    for (auto & t: this->solvers) {
+        t.join();
+    }
+
+    for (auto & c: this->connections) {
+        close(c->fd);
+        c->pending.reset();
+    }
+
+    this->solvers.clear();
+    this->connections.clear();
+    this->connected = 0;
+    this->current = nullptr;
+    this->batches.clear();
+
+    return ok;
+}
+
+void
+Server::accept()
+{
+    while (true) {
+        int fd = ::accept(this->listener, nullptr, nullptr);
+
+        if (fd < 0) {
+            // Out of descriptors, for example, leaves the others
+            // waiting in the backlog.
+            break;
+        }
+
+        set_flags(fd);
+        this->connections.push_back(std::make_shared<Connection>(fd));
+        this->connected++;
+    }
+}
+
+bool
+Server::receive(
+    const std::shared_ptr<Connection> & connection)
+{
+    auto & input = connection->input;
+    size_t used = input.size();
+
+    input.resize(used + READ_SIZE);
+
+    ssize_t n = read(connection->fd, &input[used], READ_SIZE);
+
+    input.resize(used + std::max<ssize_t>(n, 0));
+
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+
+    if (n == 0) {
+        connection->closing = true;
+        return true;
+    }
+
+    return parse(connection);
+}
+
+bool
+Server::parse(
+    const std::shared_ptr<Connection> & connection)
+{
+    auto & input = connection->input;
+    auto received = clock_t::now();
+    size_t p = 0;
+
+    if (connection->pending) {
+        auto & request = connection->pending;
+
+        if (!enqueue(request, reinterpret_cast<const uint8_t *>(&input[sizeof(Header)]))) {
+            return true;
+        }
+
+        p = sizeof(Header) + request->count * packed::PACKED_LENGTH;
+        request.reset();
+    }
+
+    // After the end of the input, requests that had to wait for a batch
+    // are still parsed.
+    while (input.size() - p >= sizeof(Header)) {
+        Header header;
+
+        std::memcpy(&header, &input[p], sizeof(header));
+
+        bool valid = header.result == Result::Ok
+            && ((header.type == Type::Solve && header.count <= MAX_COUNT)
+                || (header.type == Type::Metrics && header.count == 0));
+
+        if (!valid) {
+            header.result = Result::BadRequest;
+            header.count = 0;
+            respond(*connection, reinterpret_cast<const char *>(&header), sizeof(header));
+            connection->closing = true;
+            p = input.size();
+            break;
+        }
+
+        size_t length = sizeof(Header)
+            + (header.type == Type::Solve ? header.count * packed::PACKED_LENGTH : 0);
+
+        if (input.size() - p < length) {
+            break;
+        }
+
+        this->requests++;
+
+        if (header.type == Type::Metrics) {
+            auto metrics = get_metrics();
+            char response[sizeof(Header) + sizeof(Metrics)];
+
+            std::memcpy(response, &header, sizeof(header));
+            std::memcpy(response + sizeof(header), &metrics, sizeof(metrics));
+            respond(*connection, response, sizeof(response));
+            p += length;
+            continue;
+        }
+
+        auto request = std::make_shared<Request>();
+
+        request->connection = connection;
+        request->received = received;
+        request->response.resize(sizeof(Header) + header.count * SOLUTION_LENGTH);
+        request->count = header.count;
+        request->enqueued = 0;
+        request->remaining = header.count;
+        std::memcpy(&request->response[0], &header, sizeof(header));
+
+        if (header.count == 0) {
+            respond(*connection, request->response.data(), request->response.size());
+        } else {
+            connection->active++;
+            this->queued += header.count;
+
+            if (!enqueue(request, reinterpret_cast<const uint8_t *>(&input[p + sizeof(Header)]))) {
+                connection->pending = request;
+                break;
+            }
+        }
+
+        p += length;
+    }
+
+    input.erase(input.begin(), input.begin() + p);
+
+    return true;
+}
+
+// Puts the puzzles of a request that are not in batches yet into the
+// current batch and free ones.  Returns false when every batch is in
+// use before all of them are in.
+bool
+Server::enqueue(
+    const std::shared_ptr<Request> & request,
+    const uint8_t * puzzles)
+{
+    size_t count = request->count;
+
+    while (request->enqueued < count) {
+        if (this->current == nullptr && !this->free->try_pop(this->current)) {
+            return false;
+        }
+
+        Batch & b = *this->current;
+        size_t i = request->enqueued;
+        size_t n = std::min(count - i, this->batch_records - b.records);
+
+        if (b.records == 0) {
+            this->started = request->received;
+        }
+
+        b.slices.push_back({ request, i, b.records, n });
+
+        for (size_t k = 0; k < n; k++) {
+            packed::unpack(puzzles + (i + k) * packed::PACKED_LENGTH,
+                           &b.in[(b.records + k) * RECORD_LENGTH]);
+        }
+
+        b.records += n;
+        request->enqueued += n;
+
+        if (b.records == this->batch_records) {
+            flush();
+        }
+    }
+
+    return true;
+}
+
+void
+Server::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->work_mutex);
+
+        this->work.push_back(this->current);
+    }
+
+    this->work_ready.notify_one();
+    this->current = nullptr;
+}
+
+void
+Server::solve()
+{
+    BatchSolver solver(this->backend);
+
+    solver.get_limits().set_step_budget(this->steps);
+    solver.set_cache(this->cache);
+    solver.set_store(this->store);
+
+    while (true) {
+        Batch * b;
+
+        {
+            std::unique_lock<std::mutex> lock(this->work_mutex);
+
+            this->idle++;
+            this->work_ready.wait(lock, [this]() {
+                return !this->work.empty();
+            });
+            this->idle--;
+
+            b = this->work.front();
+            this->work.pop_front();
+        }
+
+        if (b == nullptr) {
+            break;
+        }
+
+        this->queued -= b->records;
+
+        size_t n = solver.solve_batch(b->in.data(), b->records, b->out.data(), b->status.data());
+
+        record(b->records, n);
+
+        for (auto & slice: b->slices) {
+            auto & response = slice.request->response;
+            char * p = &response[sizeof(Header) + slice.first * SOLUTION_LENGTH];
+
+            for (size_t i = slice.position; i < slice.position + slice.n; i++) {
+                p[0] = static_cast<char>(b->status[i]);
+                packed::pack(&b->out[i * RECORD_LENGTH], reinterpret_cast<uint8_t *>(p + 1));
+                p += SOLUTION_LENGTH;
+            }
+
+            if ((slice.request->remaining -= slice.n) == 0) {
+                complete(*slice.request);
+            }
+        }
+
+        b->slices.clear();
+        b->records = 0;
+        this->free->push(b);
+        wake();
+    }
+}
+
+void
+Server::complete(
+    Request & request)
+{
+    record_latency(clock_t::now() - request.received);
+    respond(*request.connection, request.response.data(), request.response.size());
+
+    // After the response, so that run() does not close the connection
+    // before it is sent.
+    request.connection->active--;
+}
+
+void
+Server::respond(
+    Connection & connection,
+    const char * data,
+    size_t length)
+{
+    std::lock_guard<std::mutex> lock(connection.mutex);
+
+    connection.output.insert(connection.output.end(), data, data + length);
+}
+
+bool
+Server::send(
+    Connection & connection)
+{
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    auto & output = connection.output;
+
+    while (connection.sent < output.size()) {
+        ssize_t n = ::send(connection.fd, &output[connection.sent],
+                           output.size() - connection.sent, MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        connection.sent += n;
+    }
+
+    output.clear();
+    connection.sent = 0;
+
+    return true;
+}
+
+void
+Server::record(
+    size_t puzzles,
+    size_t solved)
+{
+    uint64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+        clock_t::now() - this->start).count();
+    std::lock_guard<std::mutex> lock(this->metrics_mutex);
+    auto & bucket = this->seconds[second % HISTORY];
+
+    if (bucket[0] != second) {
+        bucket[0] = second;
+        bucket[1] = 0;
+    }
+
+    bucket[1] += puzzles;
+    this->puzzles += puzzles;
+    this->solved += solved;
+    this->batches_solved++;
+}
+
+void
+Server::record_latency(
+    clock_t::duration latency)
+{
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+    std::lock_guard<std::mutex> lock(this->metrics_mutex);
+
+    this->latencies[latency_bucket(ns)]++;
+    this->latency_max = std::max(this->latency_max, ns);
+}
+
+Metrics
+Server::get_metrics() const
+{
+    Metrics metrics;
+    uint64_t uptime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock_t::now() - this->start).count();
+    uint64_t second = uptime / 1000000000;
+
+    metrics.uptime = uptime;
+    metrics.threads = this->threads;
+    metrics.connections = this->connected;
+    metrics.requests = this->requests;
+    metrics.queue_depth = this->queued;
+
+    std::lock_guard<std::mutex> lock(this->metrics_mutex);
+
+    metrics.batches = this->batches_solved;
+    metrics.puzzles = this->puzzles;
+    metrics.solved = this->solved;
+
+    // The last complete seconds, or the time so far in the first one.
+    uint64_t window = std::min<uint64_t>(HISTORY, second);
+    uint64_t recent = 0;
+
+    for (auto & bucket: this->seconds) {
+        if (bucket[0] < second && bucket[0] + window >= second) {
+            recent += bucket[1];
+        }
+    }
+
+    metrics.puzzles_per_second = window > 0 ? recent / window
+        : (uptime > 0 ? this->puzzles * 1000000000 / uptime : 0);
+
+    uint64_t total = 0;
+
+    for (auto n: this->latencies) {
+        total += n;
+    }
+
+    const struct {
+        uint64_t permille;
+        uint64_t * value;
+    } percentiles[] = {
+        { 500, &metrics.latency_p50 },
+        { 900, &metrics.latency_p90 },
+        { 990, &metrics.latency_p99 },
+        { 999, &metrics.latency_p999 }
+    };
+
+    for (auto & p: percentiles) {
+        uint64_t rank = (total * p.permille + 999) / 1000;
+        uint64_t seen = 0;
+        size_t b = 0;
+
+        while (b + 1 < sizeof(this->latencies) / sizeof(this->latencies[0])
+               && (seen += this->latencies[b]) < rank) {
+            b++;
+        }
+
+        *p.value = total > 0 ? std::min(latency_bound(b), this->latency_max) : 0;
+    }
+
+    metrics.latency_max = this->latency_max;
+
+    return metrics;
+}
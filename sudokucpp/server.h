@@ -0,0 +1,155 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "protocol.h"
+#include "queue.h"
+
+namespace sudoku {
+    // Serves the protocol of protocol.h on a Unix domain socket.  One
+    // thread reads and writes all the connections with poll(), and the
+    // puzzles of the requests it reads, whatever their connection, go
+    // into shared batches for a pool of solver threads.  A batch is
+    // handed over at once while a solver thread is idle; under load it
+    // fills up for at most the linger time, so that small requests are
+    // solved together.  A fixed pool of batches bounds the puzzles in
+    // flight: while all of them are in use, the rest of a request waits,
+    // and its connection is neither parsed nor read further until a
+    // solver thread returns a batch.  Other connections are still served.
+    class Server
+    {
+    public:
+        typedef std::chrono::steady_clock clock_t;
+
+        // 0 threads for one solver per hardware thread.
+        explicit Server(Backend backend = Backend::Bitboard, size_t threads = 0,
+                        size_t batch_records = 256);
+        ~Server();
+
+        Server(const Server &) = delete;
+        Server & operator=(const Server &) = delete;
+
+        void set_step_budget(size_t steps) {
+            this->steps = steps;
+        }
+
+        void set_linger(std::chrono::microseconds linger) {
+            this->linger = linger;
+        }
+
+        // Shared by the solver threads.
+        void set_cache(std::shared_ptr<SolutionCache> cache) {
+            this->cache = cache;
+        }
+
+        void set_store(std::shared_ptr<SolutionStore> store) {
+            this->store = store;
+        }
+
+        // Binds and listens on path, replacing a socket file left there.
+        bool listen(const std::string & path);
+
+        // Serves until stop().  Returns false on an error of the
+        // listening socket.
+        bool run();
+
+        // May be called from any thread or a signal handler.
+        void stop();
+
+        protocol::Metrics get_metrics() const;
+
+        const std::string & get_error() const {
+            return this->error;
+        }
+
+    private:
+        struct Connection;
+        struct Request;
+        struct Batch;
+
+        void solve();
+        void accept();
+        bool receive(const std::shared_ptr<Connection> & connection);
+        bool parse(const std::shared_ptr<Connection> & connection);
+        bool enqueue(const std::shared_ptr<Request> & request, const uint8_t * puzzles);
+        void flush();
+        void complete(Request & request);
+        void respond(Connection & connection, const char * data, size_t length);
+        bool send(Connection & connection);
+        void wake();
+        void record(size_t puzzles, size_t solved);
+        void record_latency(clock_t::duration latency);
+
+        Backend backend;
+        size_t threads;
+        size_t batch_records;
+        size_t steps;
+        std::chrono::microseconds linger;
+        std::shared_ptr<SolutionCache> cache;
+        std::shared_ptr<SolutionStore> store;
+        std::string path;
+        std::string error;
+
+        int listener;
+        // A pipe that wakes the poll() of run().
+        int waker[2];
+        std::atomic<bool> stopping;
+
+        std::vector<std::unique_ptr<Batch>> batches;
+        std::unique_ptr<queue::BoundedQueue<Batch *>> free;
+        // Solver threads sleep while there is no work, so that an idle
+        // server does not use any CPU.
+        std::mutex work_mutex;
+        std::condition_variable work_ready;
+        std::deque<Batch *> work;
+        // The batch being filled and when its first puzzle came.
+        Batch * current;
+        clock_t::time_point started;
+        std::vector<std::shared_ptr<Connection>> connections;
+        std::atomic<size_t> connected;
+        std::vector<std::thread> solvers;
+        std::atomic<size_t> idle;
+
+        // Metrics.  Puzzles per second are counted in a ring of one
+        // second buckets, latencies in buckets of a quarter of a power
+        // of two.
+        clock_t::time_point start;
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> queued;
+        mutable std::mutex metrics_mutex;
+        uint64_t puzzles;
+        uint64_t solved;
+        uint64_t batches_solved;
+        uint64_t seconds[10][2];
+        uint64_t latencies[256];
+        uint64_t latency_max;
+    };
+}
+
+#endif
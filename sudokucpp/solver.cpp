@@ -14,16 +14,42 @@
 //  You should have received a copy of the GNU Affero General Public License
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <memory>
 
+#include "config.h"
 #include "sudoku.h"
+#include "backtrack.h"
+#include "cache.h"
 #include "eliminators.h"
+#include "engine.h"
+#include "grid.h"
+#include "instrument.h"
 
 using namespace sudoku;
 
+namespace {
+    // Row, column and box of a cell as indices to grid::tables.houses.
+    inline std::array<index_t, 3>
+    cell_houses(index_t i)
+    {
+        const auto & t = grid::tables;
+
+        return {{
+            t.row[i],
+            static_cast<index_t>(SUDOKU_NUMBERS + t.column[i]),
+            static_cast<index_t>(2 * SUDOKU_NUMBERS + t.box[i])
+        }};
+    }
+}
+
 Solver::Solver(
-    const std::string & str) {
+    const std::string & str,
+    Backend backend) : backend(backend), ordering(Ordering::Insertion),
+                       strategy(Strategy::FirstHit), missed(false), status(Status::Unsolved),
+                       backtracking(false), verbose(true), solutions(0), passes(0) {
     if (str.size() != SUDOKU_GRID_LENGTH) {
         throw std::invalid_argument("Invalid sudoku size");
     }
@@ -31,42 +57,73 @@ Solver::Solver(
     init_solved(str);
     init_candidates();
     remove_solved(solved);
+    count_candidates();
+
+    if (this->contradiction) {
+        this->status = Status::Contradiction;
+    } else if (is_solved()) {
+        this->status = Status::Solved;
+        this->solutions = 1;
+    }
+
+    add_eliminator(new eliminator::SimpleSingles());
+    add_eliminator(new eliminator::Singles());
+
+    set_profile(std::make_shared<eliminator::Profile>());
 }
 
 void
 Solver::pretty_print() const {
-    std::cout << "+-------------------+" << std::endl;
+    grid_t values;
 
-    int i = 0;
+    for (auto c: this->solved) {
+        values[cell_index(c.pos)] = c.value;
+    }
 
-    for (auto cell: this->solved) {
-        if ((i + 1) % 9 == 1) {
-            std::cout << "| ";
-        }
+    print_grid(std::cout, values);
+}
 
-        if (cell.value == 0) {
-            std::cout << ".";
-        } else {
-            std::cout << static_cast<int>(cell.value);
+Status
+Solver::solve()
+{
+    SUDOKU_TRACE("Solver::solve");
+
+    this->limits.reset();
+    this->passes = 0;
+    this->missed = false;
+
+    SUDOKU_INSTRUMENT(
+        if (this->report) {
+            this->report->begin_puzzle();
+        });
+
+    if (this->contradiction || is_solved()) {
+        return finish();
+    }
+
+    if (this->cache) {
+        grid_t solution;
+        bool unique;
+
+        if (!this->key) {
+            this->key = std::make_shared<canonical::Key>();
         }
 
-        if ((i + 1) % 9 == 0) {
-            std::cout << " |" << std::endl;
-        } else {
-            std::cout << " ";
+        *this->key = canonical::make_key(get_values());
+
+        if (this->cache->lookup(*this->key, solution, unique) && unique) {
+            apply_solution(solution);
+            this->solutions = 1;
+            return finish();
         }
 
-        i++;
+        this->missed = true;
     }
 
-    std::cout << "+-------------------+" << std::endl;
-}
-
-void
-Solver::solve()
-{
-    add_eliminator(new eliminator::SimpleSingles());
-    add_eliminator(new eliminator::Singles());
+    if (this->backend != Backend::Logic) {
+        search();
+        return finish();
+    }
 
     auto solvedgetters = CellGetter(
         [&]() { return this->solved; },
@@ -80,57 +137,344 @@ Solver::solve()
         [&](const Cell & c, index_t i) { return c.pos.column == i; },
         [&](const Cell & c, index_t i) { return c.pos.row == i; });
 
+    std::vector<size_t> order(eliminators.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+
+    auto & stats = this->profile->statistics;
+
     while (true) {
-        std::cout << "candidates left: " << candidates.size() << std::endl;
+        if (this->verbose) {
+            std::cout << "candidates left: " << candidates.size() << std::endl;
+        }
 
-        bool progress = false;
+        if (this->limits.step(1)) {
+            return finish();
+        }
 
-        for (auto elim: eliminators) {
-            auto result = elim->eliminate(solvedgetters, candgetters);
+        this->passes++;
 
-            if (result.solved.size() > 0) {
-                update_solved(result.solved);
-                progress = true;
-                break;
+        if (this->ordering != Ordering::Insertion) {
+            std::stable_sort(order.begin(), order.end(),
+                             [&stats](size_t a, size_t b) {
+                                 return stats[a].yield() > stats[b].yield();
+                             });
+        }
+
+        eliminator::Result round;
+        bool skipped = false;
+
+        // The skipped eliminators get a second sweep of their own when the
+        // others stall, so skipping never changes the result.
+        for (int sweep = 0; sweep < 2; sweep++) {
+            for (auto i: order) {
+                bool skip = this->ordering == Ordering::AdaptiveSkip
+                    && this->profile->unproductive(i);
+
+                if (skip != (sweep == 1)) {
+                    skipped |= skip;
+                    continue;
+                }
+
+                auto & elim = eliminators[i];
+                auto start = std::chrono::steady_clock::now();
+                auto result = elim->eliminate(solvedgetters, candgetters);
+                auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+
+                stats[i].calls++;
+                stats[i].nanoseconds += elapsed;
+
+                SUDOKU_INSTRUMENT(
+                    if (this->report) {
+                        this->report->record(i, result.solved.size(), result.eliminated.size(),
+                                             elapsed);
+                    });
+
+                if (result.solved.empty() && result.eliminated.empty()) {
+                    continue;
+                }
+
+                stats[i].hits++;
+                stats[i].solved += result.solved.size();
+                stats[i].eliminated += result.eliminated.size();
+
+                round.solved.insert(round.solved.end(),
+                                    result.solved.cbegin(), result.solved.cend());
+                round.eliminated.insert(round.eliminated.end(),
+                                        result.eliminated.cbegin(), result.eliminated.cend());
+
+                if (this->strategy == Strategy::FirstHit) {
+                    break;
+                }
             }
 
-            if (result.eliminated.size() > 0) {
-                // update_candidates(result.eliminated);
-                progress = true;
+            if (!skipped || !round.solved.empty() || !round.eliminated.empty()) {
                 break;
             }
         }
 
-        if (!progress) {
+        if (round.solved.empty() && round.eliminated.empty()) {
+            break;
+        }
+
+        // Several techniques often find the same cells.
+        for (auto cells: { &round.solved, &round.eliminated }) {
+            std::sort(cells->begin(), cells->end());
+            cells->erase(std::unique(cells->begin(), cells->end()), cells->end());
+        }
+
+        update_candidates(round.eliminated);
+        update_solved(round.solved);
+
+        if (this->contradiction) {
+            return finish();
+        }
+
+        if (is_solved()) {
             break;
         }
     }
 
     // elim.eliminate(this->solved, this->candidates);
+
+    if (is_solved()) {
+        this->solutions = 1;
+    } else if (this->backtracking) {
+        backtrack();
+    }
+
+    return finish();
+}
+
+Status
+Solver::finish()
+{
+    SUDOKU_INSTRUMENT(
+        if (this->report) {
+            this->report->end_puzzle();
+        });
+
+    if (this->contradiction) {
+        this->status = Status::Contradiction;
+    } else if (is_solved()) {
+        this->status = Status::Solved;
+
+        if (this->missed && this->solutions > 0) {
+            this->cache->insert(*this->key, get_values(), this->solutions == 1);
+        }
+    } else if (this->limits.get_status() != Status::Unsolved) {
+        this->status = this->limits.get_status();
+    } else {
+        this->status = Status::Unsolved;
+    }
+
+    return this->status;
+}
+
+bool
+Solver::is_solved() const
+{
+    return this->unsolved == 0 && !this->contradiction;
+}
+
+void
+Solver::count_candidates()
+{
+    this->cell_masks.fill(0);
+    this->unsolved = 0;
+    this->contradiction = false;
+
+    for (auto & h: this->house_places) {
+        h.fill(0);
+    }
+
+    for (auto & h: this->house_solved) {
+        h.fill(0);
+    }
+
+    for (auto c: candidates) {
+        auto i = cell_index(c.pos);
+
+        this->cell_masks[i] |= number_mask(c.value);
+
+        for (auto h: cell_houses(i)) {
+            this->house_places[h][c.value - 1]++;
+        }
+    }
+
+    for (auto c: solved) {
+        auto i = cell_index(c.pos);
+
+        if (c.value == 0) {
+            this->unsolved++;
+
+            if (this->cell_masks[i] == 0) {
+                this->contradiction = true;
+            }
+            continue;
+        }
+
+        for (auto h: cell_houses(i)) {
+            this->house_places[h][c.value - 1]++;
+
+            if (++this->house_solved[h][c.value - 1] > 1) {
+                this->contradiction = true;
+            }
+        }
+    }
+
+    for (auto & h: this->house_places) {
+        for (auto n: h) {
+            if (n == 0) {
+                this->contradiction = true;
+            }
+        }
+    }
+}
+
+void
+Solver::drop_candidate(
+    const Cell & c)
+{
+    auto i = cell_index(c.pos);
+
+    this->cell_masks[i] &= ~number_mask(c.value);
+
+    if (this->cell_masks[i] == 0 && this->solved[i].value == 0) {
+        this->contradiction = true;
+    }
+
+    for (auto h: cell_houses(i)) {
+        if (--this->house_places[h][c.value - 1] == 0) {
+            this->contradiction = true;
+        }
+    }
+}
+
+void
+Solver::place(
+    index_t i,
+    index_t number)
+{
+    if ((this->cell_masks[i] & number_mask(number)) == 0) {
+        this->contradiction = true;
+    }
+
+    this->unsolved--;
+
+    // The placed number keeps its place in the houses when the
+    // candidate itself is dropped.
+    for (auto h: cell_houses(i)) {
+        this->house_places[h][number - 1]++;
+
+        if (++this->house_solved[h][number - 1] > 1) {
+            this->contradiction = true;
+        }
+    }
+}
+
+void
+Solver::backtrack()
+{
+    grid_t values;
+
+    for (auto c: solved) {
+        values[cell_index(c.pos)] = c.value;
+    }
+
+    // The engines of the thread, not of the solver, since a Solver is
+    // usually built for a single puzzle.
+    auto backtracker = static_cast<backtrack::Backtracker *>(
+        engine::thread_engine(Backend::Backtracking));
+
+    {
+        engine::LimitsGuard guard(backtracker, &this->limits);
+
+        this->solutions = backtracker->solve(values, this->cell_masks);
+    }
+
+    if (this->solutions > 0) {
+        apply_solution(backtracker->get_solution());
+    } else if (this->limits.get_status() == Status::Unsolved) {
+        this->contradiction = true;
+    }
+}
+
+void
+Solver::search()
+{
+    grid_t values;
+
+    for (auto c: solved) {
+        values[cell_index(c.pos)] = c.value;
+    }
+
+    auto engine = engine::thread_engine(this->backend);
+
+    {
+        engine::LimitsGuard guard(engine, &this->limits);
+
+        this->solutions = engine->solve(values);
+    }
+
+    if (this->solutions > 0) {
+        apply_solution(engine->get_solution());
+    } else if (this->limits.get_status() == Status::Unsolved) {
+        this->contradiction = true;
+    }
+}
+
+grid_t
+Solver::get_values() const
+{
+    grid_t values;
+
+    for (auto c: solved) {
+        values[cell_index(c.pos)] = c.value;
+    }
+
+    return values;
+}
+
+void
+Solver::apply_solution(
+    const grid_t & solution)
+{
+    // A complete solution leaves no candidates, so they can all be
+    // dropped at once instead of cell by cell.
+    for (auto & c: solved) {
+        if (c.value == 0) {
+            auto i = cell_index(c.pos);
+
+            c.value = solution[i];
+            place(i, c.value);
+        }
+    }
+
+    for (auto & c: candidates) {
+        drop_candidate(c);
+    }
+
+    candidates.clear();
 }
 
 void
 Solver::init_solved(
     const std::string & str)
 {
-    int row = 1;
-    int col = 1;
-
-    std::transform(
-        str.cbegin(),
-        str.cend(),
-        back_inserter(solved),
-        [&row, &col](const char & c) {
-            index_t val = c - '0';
-            auto ncell = Cell(Position(row, col), val);
-
-            col++;
-            if (col > SUDOKU_NUMBERS) {
-                col = 1;
-                row++;
-            }
-            return ncell;
-        });
+    grid_t values;
+
+    if (!parse_grid(str.data(), str.size(), values)) {
+        throw std::invalid_argument("Invalid sudoku character");
+    }
+
+    for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+        solved.push_back(Cell(Position(i / SUDOKU_NUMBERS + 1, i % SUDOKU_NUMBERS + 1),
+                              values[i]));
+    }
 }
 
 void
@@ -162,6 +506,26 @@ Solver::remove_solved(
     candidates.erase(nend, candidates.end());
 }
 
+void
+Solver::update_candidates(
+    const cells_t & cells)
+{
+    if (cells.empty()) {
+        return;
+    }
+
+    // cells is sorted
+    auto nend = std::remove_if(candidates.begin(), candidates.end(),
+                               [this, &cells](const Cell & c) {
+                                   if (!std::binary_search(cells.cbegin(), cells.cend(), c)) {
+                                       return false;
+                                   }
+                                   drop_candidate(c);
+                                   return true;
+                               });
+    candidates.erase(nend, candidates.end());
+}
+
 void
 Solver::update_solved(
     const cells_t & cells)
@@ -173,13 +537,23 @@ Solver::update_solved(
         Cell & c = this->solved[idx];
         // c.dump(); c1.dump();
 
-        if (c.value == 0) {
+        if (c.value != 0) {
+            // Eliminators merged in one round may disagree on a cell.
+            if (c.value != c1.value) {
+                this->contradiction = true;
+            }
+        } else {
             c.value = c1.value;
+            place(idx, c.value);
 
             nend = std::remove_if(candidates.begin(), nend,
-                                 [&c](const Cell & c2) {
-                                     return (c.value == c2.value && c.pos.sees(c2.pos))
-                                     || (c.value != c2.value && c.pos == c2.pos);
+                                 [this, &c](const Cell & c2) {
+                                     if ((c.value == c2.value && c.pos.sees(c2.pos))
+                                         || (c.value != c2.value && c.pos == c2.pos)) {
+                                         drop_candidate(c2);
+                                         return true;
+                                     }
+                                     return false;
                                  });
         }
     }
@@ -191,6 +565,45 @@ Solver::add_eliminator(
     std::shared_ptr<eliminator::Eliminator> e)
 {
     this->eliminators.push_back(e);
+
+    if (this->profile) {
+        set_profile(this->profile);
+    }
+
+    if (this->report) {
+        set_report(this->report);
+    }
+}
+
+void
+Solver::set_profile(
+    std::shared_ptr<eliminator::Profile> profile)
+{
+    auto & stats = profile->statistics;
+
+    for (size_t i = 0; i < stats.size() && i < this->eliminators.size(); i++) {
+        if (std::strcmp(stats[i].name, this->eliminators[i]->name()) != 0) {
+            throw std::invalid_argument("Profile does not match the eliminators");
+        }
+    }
+
+    for (size_t i = stats.size(); i < this->eliminators.size(); i++) {
+        eliminator::Statistics st = { this->eliminators[i]->name(), 0, 0, 0, 0, 0 };
+        stats.push_back(st);
+    }
+
+    this->profile = profile;
+}
+
+void
+Solver::set_report(
+    std::shared_ptr<instrument::Report> report)
+{
+    for (size_t i = report->get_batch().size(); i < this->eliminators.size(); i++) {
+        report->add_eliminator(this->eliminators[i]->name());
+    }
+
+    this->report = report;
 }
 
 void
@@ -0,0 +1,260 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+
+#include <sys/mman.h>
+
+#include "config.h"
+#include "canonical.h"
+#include "store.h"
+
+using namespace sudoku;
+
+struct SolutionStore::Header {
+    char magic[4];
+    uint16_t version;
+    uint16_t slot_length;
+    uint32_t reserved;
+    uint64_t capacity;
+    uint64_t count;
+    char padding[32];
+};
+
+// A hash of 0 marks an empty slot.  The solution is in canonical form,
+// a nibble per cell.
+struct SolutionStore::Slot {
+    uint64_t hash;
+    uint8_t solution[(SUDOKU_GRID_LENGTH + 1) / 2];
+    uint8_t unique;
+    uint8_t backend;
+    uint8_t reserved1;
+    uint32_t steps;
+    uint8_t reserved2[8];
+};
+
+namespace {
+    const char MAGIC[4] = { 'S', 'D', 'K', 'S' };
+
+    const uint16_t STORE_VERSION = 1;
+
+    const size_t MIN_CAPACITY = 1024;
+
+    uint64_t
+    slot_hash(
+        uint64_t h)
+    {
+        return h != 0 ? h : 1;
+    }
+
+    // The solution fits the givens of the puzzle, which tells apart
+    // puzzles whose canonical forms share a hash.
+    bool
+    fits(
+        const grid_t & puzzle,
+        const grid_t & solution)
+    {
+        for (index_t i = 0; i < SUDOKU_GRID_LENGTH; i++) {
+            if (puzzle[i] != 0 && puzzle[i] != solution[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+bool
+SolutionStore::open(
+    const std::string & path)
+{
+    this->writable = false;
+
+    if (!this->file.open(path)) {
+        this->error = this->file.get_error();
+        return false;
+    }
+
+    return attach();
+}
+
+bool
+SolutionStore::open_writable(
+    const std::string & path,
+    size_t capacity)
+{
+    size_t slots = 1;
+    bool created;
+
+    while (slots < std::max(capacity, MIN_CAPACITY)) {
+        slots *= 2;
+    }
+
+    this->writable = true;
+
+    if (!this->file.open_locked(path, sizeof(Header) + slots * sizeof(Slot), created)) {
+        this->error = this->file.get_error();
+        return false;
+    }
+
+    if (!created) {
+        return attach();
+    }
+
+    // The new file reads as zeros: every slot is empty.
+    auto h = reinterpret_cast<Header *>(this->file.get_data());
+
+    std::memcpy(h->magic, MAGIC, sizeof(MAGIC));
+    h->version = STORE_VERSION;
+    h->slot_length = sizeof(Slot);
+    h->capacity = slots;
+
+    return attach();
+}
+
+bool
+SolutionStore::attach()
+{
+    static_assert(sizeof(Header) == 64, "Store header layout");
+    static_assert(sizeof(Slot) == 64, "Store slot layout");
+
+    auto h = reinterpret_cast<Header *>(this->file.get_data());
+
+    if (this->file.size() < sizeof(Header) || std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0
+        || h->version != STORE_VERSION || h->slot_length != sizeof(Slot)) {
+        this->error = "Not a solution store";
+        return false;
+    }
+
+    if (h->capacity == 0 || (h->capacity & (h->capacity - 1)) != 0
+        || (this->file.size() - sizeof(Header)) / sizeof(Slot) < h->capacity) {
+        this->error = "Truncated solution store";
+        return false;
+    }
+
+    madvise(this->file.get_data(), this->file.size(), MADV_RANDOM);
+
+    this->header = h;
+    this->slots = reinterpret_cast<Slot *>(this->file.get_data() + sizeof(Header));
+
+    return true;
+}
+
+bool
+SolutionStore::lookup(
+    const canonical::Key & key,
+    Record & record) const
+{
+    SUDOKU_TRACE("SolutionStore::lookup");
+
+    if (this->slots == nullptr) {
+        return false;
+    }
+
+    auto hash = slot_hash(key.hash);
+    auto mask = this->header->capacity - 1;
+
+    for (uint64_t i = hash & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+        const Slot & slot = this->slots[i];
+        auto h = __atomic_load_n(&slot.hash, __ATOMIC_ACQUIRE);
+
+        if (h == 0) {
+            return false;
+        }
+
+        if (h != hash) {
+            continue;
+        }
+
+        grid_t solution;
+
+        for (index_t c = 0; c < SUDOKU_GRID_LENGTH; c++) {
+            solution[c] = (slot.solution[c / 2] >> (4 * (c % 2))) & 0xf;
+        }
+
+        if (fits(key.grid, solution)) {
+            record.solution = key.transform.revert(solution);
+            record.steps = slot.steps;
+            record.backend = static_cast<Backend>(slot.backend);
+            record.unique = slot.unique != 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+SolutionStore::insert(
+    const canonical::Key & key,
+    const Record & record)
+{
+    if (!this->writable || this->slots == nullptr) {
+        return false;
+    }
+
+    Record existing;
+
+    if (lookup(key, existing)) {
+        return true;
+    }
+
+    auto solution = key.transform.apply(record.solution);
+    auto hash = slot_hash(key.hash);
+    auto mask = this->header->capacity - 1;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    if (this->header->count >= this->header->capacity - this->header->capacity / 4) {
+        return false;
+    }
+
+    // Another thread may have claimed slots since the lookup, so probe
+    // for an empty one under the lock.
+    uint64_t i = hash & mask;
+
+    while (this->slots[i].hash != 0) {
+        i = (i + 1) & mask;
+    }
+
+    Slot & slot = this->slots[i];
+
+    for (index_t c = 0; c < SUDOKU_GRID_LENGTH; c += 2) {
+        slot.solution[c / 2] = solution[c]
+            | (c + 1 < SUDOKU_GRID_LENGTH ? solution[c + 1] << 4 : 0);
+    }
+
+    slot.unique = record.unique;
+    slot.backend = static_cast<uint8_t>(record.backend);
+    slot.steps = record.steps;
+
+    __atomic_store_n(&slot.hash, hash, __ATOMIC_RELEASE);
+    __atomic_store_n(&this->header->count, this->header->count + 1, __ATOMIC_RELAXED);
+
+    return true;
+}
+
+size_t
+SolutionStore::size() const
+{
+    return this->header != nullptr ? __atomic_load_n(&this->header->count, __ATOMIC_RELAXED) : 0;
+}
+
+size_t
+SolutionStore::get_capacity() const
+{
+    return this->header != nullptr ? this->header->capacity : 0;
+}
@@ -0,0 +1,107 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef STORE_H
+#define STORE_H
+
+#include <mutex>
+
+#include "canonical.h"
+#include "mapped_file.h"
+
+namespace sudoku {
+    // Solutions kept in a memory mapped file, an open addressing hash
+    // table of fixed-size slots keyed by the hash of the canonical form
+    // of the puzzle, so that later runs and other processes can reuse
+    // them.  Any number of processes may read a store while one process
+    // adds to it: a slot is filled before its hash is published.  The
+    // writer holds an exclusive flock() on the file, and open_writable()
+    // fails in other processes meanwhile.  Threads of the writer may
+    // insert concurrently.
+    //
+    // The table does not grow; inserts fail once it is three quarters
+    // full.  Files use the native byte order.
+    class SolutionStore
+    {
+    public:
+        struct Record {
+            grid_t solution;
+            // Search steps taken to solve the puzzle, a measure of its
+            // difficulty.
+            uint32_t steps;
+            // The backend that solved it.
+            Backend backend;
+            bool unique;
+        };
+
+        SolutionStore() : header(nullptr), slots(nullptr), writable(false) {}
+
+        SolutionStore(const SolutionStore &) = delete;
+        SolutionStore & operator=(const SolutionStore &) = delete;
+
+        // Opens a store for lookups only.
+        bool open(const std::string & path);
+
+        // Opens a store for lookups and inserts, creating it with room
+        // for at least capacity slots if it does not exist.  Fails when
+        // another process has it open for writing.
+        bool open_writable(const std::string & path, size_t capacity);
+
+        // Finds the solution of puzzle, in the frame of puzzle.
+        bool lookup(const grid_t & puzzle, Record & record) const {
+            return lookup(canonical::make_key(puzzle), record);
+        }
+
+        // With the key of the puzzle, for callers that also use it with
+        // a SolutionCache.
+        bool lookup(const canonical::Key & key, Record & record) const;
+
+        // Returns false when the store is full or read-only.  A puzzle
+        // already in the store is left as it is.
+        bool insert(const grid_t & puzzle, const Record & record) {
+            return insert(canonical::make_key(puzzle), record);
+        }
+
+        bool insert(const canonical::Key & key, const Record & record);
+
+        size_t size() const;
+
+        size_t get_capacity() const;
+
+        bool is_writable() const {
+            return this->writable;
+        }
+
+        const std::string & get_error() const {
+            return this->error;
+        }
+
+    private:
+        struct Header;
+        struct Slot;
+
+        bool attach();
+
+        MappedFile file;
+        Header * header;
+        Slot * slots;
+        bool writable;
+        std::mutex mutex;
+        std::string error;
+    };
+}
+
+#endif
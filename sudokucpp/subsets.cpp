@@ -0,0 +1,65 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "config.h"
+#include "subsets.h"
+
+using namespace sudoku;
+
+namespace {
+    constexpr subset::Tables
+    make_tables()
+    {
+        subset::Tables t{};
+        uint16_t n = 0;
+
+        for (index_t k = 0; k <= SUDOKU_NUMBERS; k++) {
+            t.offsets[k] = n;
+
+            for (size_t m = 0; m < subset::SUBSETS; m++) {
+                index_t bits = 0;
+
+                for (size_t x = m; x != 0; x &= x - 1) {
+                    bits++;
+                }
+
+                if (bits == k) {
+                    t.masks[n++] = static_cast<mask_t>(m);
+                }
+            }
+        }
+        t.offsets[SUDOKU_NUMBERS + 1] = n;
+
+        for (index_t i = 0; i <= SUDOKU_NUMBERS; i++) {
+            t.binomial[i][0] = 1;
+
+            for (index_t j = 1; j <= i; j++) {
+                t.binomial[i][j] = t.binomial[i - 1][j - 1]
+                    + (j < i ? t.binomial[i - 1][j] : 0);
+            }
+        }
+
+        return t;
+    }
+
+    constexpr subset::Tables checked = make_tables();
+
+    static_assert(checked.offsets[SUDOKU_NUMBERS + 1] == subset::SUBSETS,
+                  "every subset is listed once");
+    static_assert(checked.binomial[SUDOKU_NUMBERS][4] == 126, "binomial table");
+}
+
+const subset::Tables sudoku::subset::tables = checked;
@@ -0,0 +1,75 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef SUBSETS_H
+#define SUBSETS_H
+
+#include "sudoku.h"
+
+namespace sudoku {
+    namespace subset {
+        const size_t SUBSETS = 1 << SUDOKU_NUMBERS;
+
+        // Every subset of {0, ..., 8} as a bitmask, grouped by size.  The
+        // subsets of size k are masks[offsets[k]] ... masks[offsets[k + 1] - 1]
+        // in increasing order, so the ones that fit in n < 9 elements are
+        // the first binomial[n][k] of the group.
+        struct Tables {
+            mask_t masks[SUBSETS];
+            uint16_t offsets[SUDOKU_NUMBERS + 2];
+            index_t binomial[SUDOKU_NUMBERS + 1][SUDOKU_NUMBERS + 1];
+        };
+
+        extern const Tables tables;
+
+        struct Range {
+            const mask_t * first;
+            const mask_t * last;
+
+            const mask_t * begin() const {
+                return this->first;
+            }
+
+            const mask_t * end() const {
+                return this->last;
+            }
+
+            size_t size() const {
+                return this->last - this->first;
+            }
+        };
+
+        // The subsets of size k of {0, ..., n - 1}, n <= 9.  Throws
+        // std::invalid_argument for larger n.
+        //
+        //     for (auto m: subset::subsets(house_size, 3)) { ... }
+        inline Range subsets(size_t n, size_t k) {
+            if (n > SUDOKU_NUMBERS) {
+                throw std::invalid_argument("Too many elements for subset tables");
+            }
+
+            if (k > n) {
+                return Range{ tables.masks, tables.masks };
+            }
+
+            const mask_t * first = tables.masks + tables.offsets[k];
+
+            return Range{ first, first + tables.binomial[n][k] };
+        }
+    }
+}
+
+#endif
@@ -18,6 +18,9 @@
 #define SUDOKU_H
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <list>
 #include <map>
@@ -29,13 +32,7 @@
 
 #include <cstdint>
 
-#if HAVE_LIBACE
-#include <ace/OS.h>
-#include <ace/Trace.h>
-#else
-#define ACE_TRACE(x)
-#define ACE_TEXT(x)
-#endif
+#include "trace.h"
 
 namespace sudoku
 {
@@ -47,6 +44,14 @@ namespace sudoku
     const index_t SUDOKU_GRID_LENGTH = SUDOKU_NUMBERS * SUDOKU_NUMBERS;
     const index_t SUDOKU_COLUMNS = SUDOKU_NUMBERS;
     const index_t SUDOKU_ROWS = SUDOKU_NUMBERS;
+    const index_t SUDOKU_HOUSES = 3 * SUDOKU_NUMBERS;
+
+    // Cell values in row-major order, 0 for an unsolved cell.
+    typedef std::array<index_t, SUDOKU_GRID_LENGTH> grid_t;
+
+    // Candidate sets as bitmasks, bit (n - 1) set when number n is possible.
+    typedef uint16_t mask_t;
+    typedef std::array<mask_t, SUDOKU_GRID_LENGTH> masks_t;
 
     struct Position
     {
@@ -69,6 +74,10 @@ namespace sudoku
             return this->row == other.row && this->column == other.column;
         }
 
+        bool operator!=(const Position & other) const {
+            return !(*this == other);
+        }
+
         bool eq_row(const Position & other) const {
             return this->row == other.row;
         }
@@ -96,6 +105,18 @@ namespace sudoku
             this->value = v;
         }
 
+        bool operator<(const Cell & other) const {
+            if (this->pos == other.pos) {
+                return this->value < other.value;
+            }
+
+            return this->pos < other.pos;
+        }
+
+        bool operator==(const Cell & other) const {
+            return this->pos == other.pos && this->value == other.value;
+        }
+
         void dump(void) const;
 
         Position    pos;
@@ -121,7 +142,7 @@ namespace sudoku
         }
 
         const cells_t get_box(index_t i) const {
-            ACE_TRACE(ACE_TEXT("CellGetter::get_box"));
+            SUDOKU_TRACE("CellGetter::get_box");
 
             auto all = this->get_all();
             cells_t res;
@@ -134,7 +155,7 @@ namespace sudoku
         }
 
         const cells_t get_column(index_t i) const {
-            ACE_TRACE(ACE_TEXT("CellGetter::get_column"));
+            SUDOKU_TRACE("CellGetter::get_column");
 
             auto all = this->get_all();
             cells_t res;
@@ -146,7 +167,7 @@ namespace sudoku
         }
 
         const cells_t get_row(index_t i) const {
-            ACE_TRACE(ACE_TEXT("CellGetter::get_row"));
+            SUDOKU_TRACE("CellGetter::get_row");
 
             auto all = this->get_all();
             cells_t res;
@@ -165,26 +186,247 @@ namespace sudoku
         std::function<bool(const Cell &, index_t)> get_row_filter;
     };
 
+    enum class Status {
+        Unsolved,
+        Solved,
+        Contradiction,
+        TimedOut,
+        Cancelled,
+        // Malformed batch input.
+        Invalid
+    };
+
+    // Lets another thread ask a running solve() to stop.
+    class CancellationToken
+    {
+    public:
+        CancellationToken() : cancelled(false) {}
+
+        void cancel() {
+            this->cancelled.store(true, std::memory_order_relaxed);
+        }
+
+        bool is_cancelled() const {
+            return this->cancelled.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<bool> cancelled;
+    };
+
+    // Deadline, step budget and cancellation for one solve().  Solver
+    // counts a step per eliminator pass and the search engines one per
+    // node, so the limits are checked cooperatively at those points.
+    class Limits
+    {
+    public:
+        typedef std::chrono::steady_clock clock_t;
+
+        Limits() : steps(0), max_steps(0), has_deadline(false),
+                   status(Status::Unsolved) {}
+
+        void set_deadline(clock_t::time_point deadline) {
+            this->deadline = deadline;
+            this->has_deadline = true;
+        }
+
+        void set_timeout(clock_t::duration timeout) {
+            set_deadline(clock_t::now() + timeout);
+        }
+
+        // 0 for no limit.
+        void set_step_budget(size_t steps) {
+            this->max_steps = steps;
+        }
+
+        void set_cancellation_token(std::shared_ptr<CancellationToken> token) {
+            this->token = token;
+        }
+
+        void reset() {
+            this->steps = 0;
+            this->status = Status::Unsolved;
+        }
+
+        // Counts a step.  Returns true once a limit has been hit; the
+        // clock is read on the first step and then every clock_interval
+        // steps.
+        bool step(size_t clock_interval = 64) {
+            if (this->status != Status::Unsolved) {
+                return true;
+            }
+
+            this->steps++;
+
+            if (this->max_steps != 0 && this->steps > this->max_steps) {
+                this->status = Status::TimedOut;
+            } else if (this->token && this->token->is_cancelled()) {
+                this->status = Status::Cancelled;
+            } else if (this->has_deadline && (this->steps - 1) % clock_interval == 0
+                       && clock_t::now() >= this->deadline) {
+                this->status = Status::TimedOut;
+            }
+
+            return this->status != Status::Unsolved;
+        }
+
+        // Status::Unsolved while no limit has been hit.
+        Status get_status() const {
+            return this->status;
+        }
+
+        size_t get_steps() const {
+            return this->steps;
+        }
+
+    private:
+        size_t steps;
+        size_t max_steps;
+        bool has_deadline;
+        clock_t::time_point deadline;
+        std::shared_ptr<CancellationToken> token;
+        Status status;
+    };
+
     namespace eliminator {
         class Eliminator;
+        struct Profile;
     }
 
+    namespace instrument {
+        class Report;
+    }
+
+    namespace canonical {
+        struct Key;
+    }
+
+    class SolutionCache;
+
+    // How Solver::solve() works out the solution: with the logical
+    // eliminators, or by handing the whole puzzle to a search engine.
+    enum class Backend {
+        Logic,
+        Backtracking,
+        DancingLinks,
+        Bitboard,
+        Cdcl
+    };
+
+    // The order in which Solver tries the eliminators on each pass.
+    // Adaptive ranks them by solved and eliminated candidates per
+    // nanosecond spent, as recorded in the solver's profile.
+    // AdaptiveSkip also leaves out the eliminators that the profile
+    // finds unproductive, unless the others make no progress.
+    enum class Ordering {
+        Insertion,
+        Adaptive,
+        AdaptiveSkip
+    };
+
+    // FirstHit applies the result of the first eliminator that makes
+    // progress and starts a new pass.  Fixpoint runs every eliminator on
+    // each pass and applies their merged results at once.
+    enum class Strategy {
+        FirstHit,
+        Fixpoint
+    };
+
     class Solver
     {
     public:
-        Solver(const std::string & str);
+        Solver(const std::string & str, Backend backend = Backend::Logic);
 
         virtual const cells_t & get_candidates() const {
             return this->candidates;
         }
 
+        virtual const cells_t & get_solved() const {
+            return this->solved;
+        }
+
+        // Number of solutions found, 0 until the grid has been completed.
+        // With backtracking a second solution is searched for, so a value
+        // of 2 means that the puzzle is not unique.
+        virtual size_t get_solution_count() const {
+            return this->solutions;
+        }
+
+        // Fall back to a search when the logical techniques stall.
+        virtual void set_backtracking(bool enabled) {
+            this->backtracking = enabled;
+        }
+
+        virtual void set_ordering(Ordering ordering) {
+            this->ordering = ordering;
+        }
+
+        virtual void set_strategy(Strategy strategy) {
+            this->strategy = strategy;
+        }
+
+        // Print the number of candidates left on each pass, on by default.
+        virtual void set_verbose(bool verbose) {
+            this->verbose = verbose;
+        }
+
+        // Eliminator passes made by solve().
+        virtual size_t get_passes() const {
+            return this->passes;
+        }
+
+        // Use a profile shared with other solvers, so that adaptive
+        // ordering learns across a batch instead of per puzzle.  Throws
+        // std::invalid_argument when the profile was recorded for other
+        // eliminators.
+        virtual void set_profile(std::shared_ptr<eliminator::Profile> profile);
+
+        virtual const eliminator::Profile & get_profile() const {
+            return *this->profile;
+        }
+
+        // Eliminator counters and latency histograms, recorded only when
+        // the library is built with instrumentation.  A report can be
+        // shared by the solvers of a batch.
+        virtual void set_report(std::shared_ptr<instrument::Report> report);
+
+        virtual std::shared_ptr<instrument::Report> get_report() const {
+            return this->report;
+        }
+
+        // Look puzzles up in a cache shared with other solvers before
+        // solving them, and add the unique solutions found.
+        virtual void set_cache(std::shared_ptr<SolutionCache> cache) {
+            this->cache = cache;
+        }
+
+        virtual Limits & get_limits() {
+            return this->limits;
+        }
+
+        // Known right after construction for puzzles that are already
+        // complete or contradictory, otherwise set by solve().
+        virtual Status get_status() const {
+            return this->status;
+        }
+
+        virtual bool is_solved() const;
         virtual void pretty_print() const;
-        virtual void solve();
+        virtual Status solve();
     protected:
         virtual void init_solved(const std::string & str);
         virtual void init_candidates();
         virtual void remove_solved(const cells_t & cells);
+        virtual void update_candidates(const cells_t & cells);
         virtual void update_solved(const cells_t & cells);
+        virtual void backtrack();
+        virtual void search();
+        virtual void apply_solution(const grid_t & solution);
+        virtual Status finish();
+        virtual void count_candidates();
+        virtual void drop_candidate(const Cell & c);
+        virtual void place(index_t i, index_t number);
+        virtual grid_t get_values() const;
 
         virtual void add_eliminator(std::shared_ptr<eliminator::Eliminator>);
         virtual void add_eliminator(eliminator::Eliminator *);
@@ -192,6 +434,33 @@ namespace sudoku
         cells_t candidates;
         cells_t solved;
         std::vector<std::shared_ptr<eliminator::Eliminator>> eliminators;
+
+        Backend backend;
+        Ordering ordering;
+        Strategy strategy;
+        std::shared_ptr<eliminator::Profile> profile;
+        std::shared_ptr<instrument::Report> report;
+        std::shared_ptr<SolutionCache> cache;
+        // The key of the puzzle, made once for both the lookup and the
+        // insert of its solution, and kept for the next puzzle.
+        std::shared_ptr<canonical::Key> key;
+        // The puzzle missed in the cache, so that it is inserted once
+        // solved.
+        bool missed;
+        // Invariants kept up to date as candidates are removed, so that
+        // contradictions and a completed grid are noticed immediately.
+        masks_t cell_masks;
+        std::array<std::array<index_t, SUDOKU_NUMBERS>, SUDOKU_HOUSES> house_places;
+        std::array<std::array<index_t, SUDOKU_NUMBERS>, SUDOKU_HOUSES> house_solved;
+        index_t unsolved;
+        bool contradiction;
+
+        Limits limits;
+        Status status;
+        bool backtracking;
+        bool verbose;
+        size_t solutions;
+        size_t passes;
     };
 }
 
@@ -0,0 +1,202 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "config.h"
+#include "trace.h"
+
+using namespace sudoku;
+
+#if SUDOKU_NO_TRACING
+const bool sudoku::trace::enabled = false;
+#else
+const bool sudoku::trace::enabled = true;
+#endif
+
+thread_local bool sudoku::trace::sampled = false;
+
+namespace {
+    // Single writer, the owning thread.  The fields are atomic so that
+    // an exporter may read a slot while it is being overwritten; such
+    // slots are detected from head and skipped.
+    struct Event
+    {
+        std::atomic<const char *> name;
+        std::atomic<uint64_t> begin;
+        std::atomic<uint64_t> end;
+    };
+
+    struct Ring
+    {
+        explicit Ring(size_t tid) : tid(tid), head(0), start(0) {}
+
+        size_t tid;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> start;
+        Event events[trace::RING_EVENTS];
+    };
+
+    // Rings outlive their threads, so that the events of finished
+    // threads can still be exported, and are handed on to new threads.
+    // Memory is bounded by the most threads tracing at once, and a
+    // thread shares its tid with the finished ones that used its ring.
+    std::mutex registry_mutex;
+    std::vector<std::shared_ptr<Ring>> registry;
+    std::vector<Ring *> spare;
+
+    struct Owner
+    {
+        Ring * ring = nullptr;
+
+        ~Owner() {
+            if (this->ring != nullptr) {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+
+                spare.push_back(this->ring);
+            }
+        }
+    };
+
+    thread_local Owner owner;
+
+    Ring *
+    thread_ring()
+    {
+        if (owner.ring == nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+
+            if (!spare.empty()) {
+                owner.ring = spare.back();
+                spare.pop_back();
+            } else {
+                registry.push_back(std::make_shared<Ring>(registry.size() + 1));
+                owner.ring = registry.back().get();
+            }
+        }
+
+        return owner.ring;
+    }
+
+    // Chrome traces count in microseconds.
+    void
+    write_microseconds(
+        std::ostream & os,
+        uint64_t ns)
+    {
+        char fraction[4] = {
+            char('0' + ns / 100 % 10),
+            char('0' + ns / 10 % 10),
+            char('0' + ns % 10),
+            0
+        };
+
+        os << ns / 1000 << "." << fraction;
+    }
+
+    std::vector<std::shared_ptr<Ring>>
+    rings()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+
+        return registry;
+    }
+}
+
+uint64_t
+trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+trace::record(
+    const char * name,
+    uint64_t begin,
+    uint64_t end)
+{
+    Ring * r = thread_ring();
+    uint64_t h = r->head.load(std::memory_order_relaxed);
+    Event & e = r->events[(h / 2) % RING_EVENTS];
+
+    // An odd head tells a concurrent export that the slot is being
+    // written, like a seqlock.
+    r->head.store(h + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    e.name.store(name, std::memory_order_relaxed);
+    e.begin.store(begin, std::memory_order_relaxed);
+    e.end.store(end, std::memory_order_relaxed);
+
+    r->head.store(h + 2, std::memory_order_release);
+}
+
+void
+trace::write_chrome_json(
+    std::ostream & os)
+{
+    bool first = true;
+
+    os << "{\"traceEvents\": [";
+
+    for (auto & r: rings()) {
+        // Even head values are stable, odd ones mid-write.
+        uint64_t head = r->head.load(std::memory_order_acquire) / 2 * 2;
+        uint64_t start = r->start.load(std::memory_order_relaxed);
+        uint64_t lowest = head > 2 * RING_EVENTS ? head - 2 * RING_EVENTS : 0;
+
+        for (uint64_t h = std::max(start, lowest); h < head; h += 2) {
+            const Event & e = r->events[(h / 2) % RING_EVENTS];
+            const char * name = e.name.load(std::memory_order_relaxed);
+            uint64_t begin = e.begin.load(std::memory_order_relaxed);
+            uint64_t end = e.end.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            // Overwritten while being read.
+            if (r->head.load(std::memory_order_relaxed) > h + 2 * RING_EVENTS) {
+                continue;
+            }
+
+            os << (first ? "" : ",") << "\n{\"name\": \"" << name
+               << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << r->tid
+               << ", \"ts\": ";
+            write_microseconds(os, begin);
+            os << ", \"dur\": ";
+            write_microseconds(os, end - begin);
+            os << "}";
+            first = false;
+        }
+    }
+
+    os << "\n], \"displayTimeUnit\": \"ns\"}" << std::endl;
+}
+
+void
+trace::clear()
+{
+    for (auto & r: rings()) {
+        r->start.store(r->head.load(std::memory_order_acquire) / 2 * 2,
+                       std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,107 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <iosfwd>
+
+#include "trace_config.h"
+
+// Built-in tracing of timestamped spans.  SUDOKU_TRACE("name") traces
+// the rest of the enclosing scope when the current thread is sampled,
+// see trace::Sample.  Unsampled threads pay for one thread local test,
+// and ./configure --disable-tracing removes the spans altogether.
+#if SUDOKU_NO_TRACING
+#define SUDOKU_TRACE(name)
+#else
+#define SUDOKU_TRACE_CAT2(a, b) a ## b
+#define SUDOKU_TRACE_CAT(a, b) SUDOKU_TRACE_CAT2(a, b)
+#define SUDOKU_TRACE(name) \
+    ::sudoku::trace::Span SUDOKU_TRACE_CAT(sudoku_trace_span_, __LINE__)(name)
+#endif
+
+namespace sudoku {
+    namespace trace {
+        // True when the library was built with tracing.
+        extern const bool enabled;
+
+        // Events kept per thread; older ones are overwritten.
+        const size_t RING_EVENTS = 1 << 13;
+
+        extern thread_local bool sampled;
+
+        uint64_t now();
+
+        // Appends a complete event to the ring buffer of this thread.
+        void record(const char * name, uint64_t begin, uint64_t end);
+
+        class Span
+        {
+        public:
+            explicit Span(const char * name) : name(sampled ? name : nullptr), begin(0) {
+                if (this->name != nullptr) {
+                    this->begin = now();
+                }
+            }
+
+            ~Span() {
+                if (this->name != nullptr) {
+                    record(this->name, this->begin, now());
+                }
+            }
+
+            Span(const Span &) = delete;
+            Span & operator=(const Span &) = delete;
+
+        private:
+            const char * name;
+            uint64_t begin;
+        };
+
+        // Samples the spans of this thread while in scope, e.g. for one
+        // request out of a hundred.
+        class Sample
+        {
+        public:
+            explicit Sample(bool on = true) : previous(sampled) {
+                sampled = on;
+            }
+
+            ~Sample() {
+                sampled = this->previous;
+            }
+
+            Sample(const Sample &) = delete;
+            Sample & operator=(const Sample &) = delete;
+
+        private:
+            bool previous;
+        };
+
+        // Writes the events of all threads in the Chrome trace event
+        // format, for chrome://tracing or Perfetto.  Threads may keep
+        // tracing meanwhile; events overwritten during the export are
+        // left out.
+        void write_chrome_json(std::ostream & os);
+
+        // Forgets the events recorded so far.
+        void clear();
+    }
+}
+
+#endif
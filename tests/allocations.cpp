@@ -0,0 +1,104 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstdlib>
+#include <new>
+
+#include "allocations.h"
+
+namespace {
+    thread_local size_t count = 0;
+
+    void *
+    allocate(
+        size_t size)
+    {
+        count++;
+
+        return std::malloc(size == 0 ? 1 : size);
+    }
+}
+
+size_t
+sudoku::test::allocations()
+{
+    return count;
+}
+
+void *
+operator new(
+    size_t size)
+{
+    void * p = allocate(size);
+
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *
+operator new[](
+    size_t size)
+{
+    return operator new(size);
+}
+
+void *
+operator new(
+    size_t size,
+    const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *
+operator new[](
+    size_t size,
+    const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void
+operator delete(
+    void * p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete[](
+    void * p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(
+    void * p,
+    size_t) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete[](
+    void * p,
+    size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,50 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <cstddef>
+
+#include <gtest/gtest.h>
+
+// The test binary replaces the global operator new to count the heap
+// allocations made by each thread.
+namespace sudoku {
+    namespace test {
+        size_t allocations();
+
+        template <typename F>
+        size_t count_allocations(F f) {
+            size_t before = allocations();
+
+            f();
+
+            return allocations() - before;
+        }
+    }
+}
+
+// The statement may contain commas, hence the variadic macro.
+#define EXPECT_NO_ALLOCATIONS(...)                                      \
+    do {                                                                \
+        size_t sudoku_allocations_ =                                    \
+            ::sudoku::test::count_allocations([&]() { __VA_ARGS__; }); \
+        EXPECT_EQ(sudoku_allocations_, 0U)                              \
+            << "allocated in: " #__VA_ARGS__;                           \
+    } while (0)
+
+#endif
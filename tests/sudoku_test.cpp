@@ -15,10 +15,61 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <csignal>
+#include <cstdio>
 #include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 
 #include "sudokucpp/sudoku.h"
+#include "sudokucpp/backtrack.h"
+#include "sudokucpp/batch.h"
+#include "sudokucpp/bitboard.h"
+#include "sudokucpp/cache.h"
+#include "sudokucpp/cdcl.h"
+#include "sudokucpp/client.h"
+#include "sudokucpp/combinations.h"
+#include "sudokucpp/dlx.h"
+#include "sudokucpp/eliminators.h"
+#include "sudokucpp/engine.h"
+#include "sudokucpp/instrument.h"
+#include "sudokucpp/packed.h"
+#include "sudokucpp/parallel.h"
+#include "sudokucpp/permutations.h"
+#include "sudokucpp/pipeline.h"
+#include "sudokucpp/queue.h"
+#include "sudokucpp/server.h"
+#include "sudokucpp/store.h"
+#include "sudokucpp/subsets.h"
+#include "sudokucpp/trace.h"
+
+#include "allocations.h"
+
+static bool
+valid_solution(const sudoku::cells_t & cells)
+{
+    std::set<std::tuple<int, int, int>> seen;
+
+    for (auto c: cells) {
+        if (c.value < 1 || c.value > 9) {
+            return false;
+        }
+
+        if (!seen.insert(std::make_tuple(0, c.pos.row, c.value)).second
+            || !seen.insert(std::make_tuple(1, c.pos.column, c.value)).second
+            || !seen.insert(std::make_tuple(2, c.pos.box, c.value)).second) {
+            return false;
+        }
+    }
+
+    return cells.size() == 81U;
+}
 
 TEST(SudokuTest, SolvePuzzle1)
 {
@@ -36,6 +87,1343 @@ TEST(SudokuTest, SolvePuzzle1)
     EXPECT_EQ(cands.size(), 77U) << "Expected 77 candidates left, got " << cands.size();
 }
 
+TEST(SudokuTest, SolvePuzzle1Backtracking)
+{
+    auto puzzle = sudoku::Solver(
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+
+    puzzle.set_backtracking(true);
+    puzzle.solve();
+
+    EXPECT_EQ(puzzle.get_candidates().size(), 0U);
+    EXPECT_TRUE(puzzle.is_solved());
+    EXPECT_TRUE(valid_solution(puzzle.get_solved()));
+    EXPECT_EQ(puzzle.get_solution_count(), 1U);
+}
+
+TEST(SudokuTest, SolveHardBacktracking)
+{
+    auto puzzle = sudoku::Solver(
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400");
+
+    puzzle.set_backtracking(true);
+    puzzle.solve();
+
+    EXPECT_TRUE(puzzle.is_solved());
+    EXPECT_TRUE(valid_solution(puzzle.get_solved()));
+    EXPECT_EQ(puzzle.get_solution_count(), 1U);
+}
+
+TEST(SudokuTest, AdaptiveOrdering)
+{
+    auto profile = std::make_shared<sudoku::eliminator::Profile>();
+
+    for (int i = 0; i < 2; i++) {
+        auto puzzle = sudoku::Solver(
+            "000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+
+        puzzle.set_ordering(sudoku::Ordering::Adaptive);
+        puzzle.set_profile(profile);
+        puzzle.solve();
+
+        EXPECT_EQ(puzzle.get_candidates().size(), 77U);
+    }
+
+    ASSERT_EQ(profile->statistics.size(), 2U);
+
+    size_t solved = 0;
+
+    for (auto & st: profile->statistics) {
+        EXPECT_GT(st.calls, 0U) << st.name;
+        EXPECT_LE(st.hits, st.calls) << st.name;
+        solved += st.solved;
+    }
+
+    EXPECT_GT(solved, 0U);
+}
+
+TEST(SudokuTest, AdaptiveSkipOrdering)
+{
+    auto profile = std::make_shared<sudoku::eliminator::Profile>();
+    auto puzzle = sudoku::Solver(
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+
+    puzzle.set_profile(profile);
+    ASSERT_EQ(profile->statistics.size(), 2U);
+
+    // SimpleSingles looks unproductive, so it runs only when Singles stalls.
+    profile->statistics[0].calls = 1000;
+    ASSERT_TRUE(profile->unproductive(0));
+
+    puzzle.set_ordering(sudoku::Ordering::AdaptiveSkip);
+    puzzle.set_strategy(sudoku::Strategy::Fixpoint);
+    puzzle.set_verbose(false);
+    puzzle.solve();
+
+    EXPECT_EQ(puzzle.get_candidates().size(), 77U);
+    EXPECT_LT(profile->statistics[0].calls, 1000U + puzzle.get_passes());
+    EXPECT_EQ(profile->statistics[1].calls, puzzle.get_passes());
+}
+
+TEST(SudokuTest, ProfileMismatch)
+{
+    auto profile = std::make_shared<sudoku::eliminator::Profile>();
+    sudoku::eliminator::Statistics st = { "Fish", 0, 0, 0, 0, 0 };
+
+    profile->statistics.push_back(st);
+
+    auto puzzle = sudoku::Solver(
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+
+    EXPECT_THROW(puzzle.set_profile(profile), std::invalid_argument);
+}
+
+TEST(SudokuTest, FixpointStrategy)
+{
+    const std::string str =
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000";
+
+    auto first = sudoku::Solver(str);
+    first.solve();
+
+    auto fixpoint = sudoku::Solver(str);
+    fixpoint.set_strategy(sudoku::Strategy::Fixpoint);
+    fixpoint.solve();
+
+    EXPECT_EQ(fixpoint.get_candidates().size(), 77U);
+    EXPECT_EQ(fixpoint.get_candidates().size(), first.get_candidates().size());
+    EXPECT_LT(fixpoint.get_passes(), first.get_passes());
+}
+
+TEST(SudokuTest, StepBudget)
+{
+    auto puzzle = sudoku::Solver(
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+
+    puzzle.get_limits().set_step_budget(2);
+
+    EXPECT_EQ(puzzle.solve(), sudoku::Status::TimedOut);
+    EXPECT_GT(puzzle.get_candidates().size(), 77U);
+
+    puzzle.get_limits().set_step_budget(0);
+    puzzle.set_backtracking(true);
+
+    EXPECT_EQ(puzzle.solve(), sudoku::Status::Solved);
+    EXPECT_TRUE(valid_solution(puzzle.get_solved()));
+}
+
+TEST(SudokuTest, Cancelled)
+{
+    auto token = std::make_shared<sudoku::CancellationToken>();
+    auto puzzle = sudoku::Solver(
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        sudoku::Backend::DancingLinks);
+
+    puzzle.get_limits().set_cancellation_token(token);
+    token->cancel();
+
+    EXPECT_EQ(puzzle.solve(), sudoku::Status::Cancelled);
+    EXPECT_FALSE(puzzle.is_solved());
+
+    // The engine of the thread does not keep the limits of the solver.
+    sudoku::grid_t grid;
+
+    sudoku::parse_grid(
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        sudoku::SUDOKU_GRID_LENGTH, grid);
+    EXPECT_EQ(sudoku::engine::thread_engine(sudoku::Backend::DancingLinks)->solve(grid), 1U);
+}
+
+TEST(SudokuTest, Deadline)
+{
+    auto puzzle = sudoku::Solver(
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        sudoku::Backend::Cdcl);
+
+    puzzle.get_limits().set_deadline(std::chrono::steady_clock::now());
+    EXPECT_EQ(puzzle.solve(), sudoku::Status::TimedOut);
+
+    puzzle.get_limits().set_timeout(std::chrono::seconds(60));
+    EXPECT_EQ(puzzle.solve(), sudoku::Status::Solved);
+}
+
+TEST(SudokuTest, ContradictoryGivens)
+{
+    auto puzzle = sudoku::Solver(
+        "110000000000000000000000000000000000000000000000000000000000000000000000000000000");
+
+    EXPECT_EQ(puzzle.get_status(), sudoku::Status::Contradiction);
+    EXPECT_EQ(puzzle.solve(), sudoku::Status::Contradiction);
+    EXPECT_EQ(puzzle.get_passes(), 0U);
+    EXPECT_FALSE(puzzle.is_solved());
+}
+
+namespace {
+    class MergingSolver : public sudoku::Solver
+    {
+    public:
+        explicit MergingSolver(const std::string & str) : sudoku::Solver(str) {
+        }
+
+        sudoku::Status merge(const sudoku::cells_t & cells) {
+            update_solved(cells);
+            return finish();
+        }
+    };
+}
+
+TEST(SudokuTest, ConflictingMergedRound)
+{
+    MergingSolver puzzle(
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+    sudoku::cells_t cells;
+
+    // Two candidates of the first cell, as two eliminators might solve it.
+    for (auto & c: puzzle.get_candidates()) {
+        if (c.pos == sudoku::Position(1, 1) && cells.size() < 2) {
+            cells.push_back(c);
+        }
+    }
+
+    ASSERT_EQ(cells.size(), 2U);
+    EXPECT_EQ(puzzle.merge(cells), sudoku::Status::Contradiction);
+}
+
+TEST(SudokuTest, AlreadySolved)
+{
+    auto puzzle = sudoku::Solver(
+        "534678912672195348198342567859761423426853791713924856961537284287419635345286179");
+
+    EXPECT_EQ(puzzle.get_status(), sudoku::Status::Solved);
+    EXPECT_TRUE(puzzle.is_solved());
+    EXPECT_EQ(puzzle.solve(), sudoku::Status::Solved);
+    EXPECT_EQ(puzzle.get_passes(), 0U);
+    EXPECT_EQ(puzzle.get_solution_count(), 1U);
+}
+
+TEST(SudokuTest, NoSolution)
+{
+    // The first given of the hard puzzle changed from 8 to 1.
+    std::string str =
+        "100000000003600000070090200050007000000045700000100030001000068008500010090000400";
+
+    for (auto backend: { sudoku::Backend::Backtracking, sudoku::Backend::DancingLinks,
+                         sudoku::Backend::Bitboard, sudoku::Backend::Cdcl }) {
+        auto puzzle = sudoku::Solver(str, backend);
+
+        EXPECT_EQ(puzzle.get_status(), sudoku::Status::Unsolved);
+        EXPECT_EQ(puzzle.solve(), sudoku::Status::Contradiction);
+        EXPECT_EQ(puzzle.get_solution_count(), 0U);
+    }
+}
+
+TEST(CombinationTest, RangesMatchCombination)
+{
+    using namespace sudoku::combination;
+
+    for (size_t n = 0; n <= 9; n++) {
+        for (size_t k = 0; k <= n + 1; k++) {
+            std::set<subset_t> expected;
+
+            for (subset_t m = 0; m < (subset_t(1) << n); m++) {
+                if (size_t(__builtin_popcount(m)) == k) {
+                    expected.insert(m);
+                }
+            }
+
+            // Algorithm T needs 0 < k < n.
+            if (k > 0 && k < n) {
+                std::set<subset_t> visited;
+                Combination comb(n, k);
+
+                while (auto c = comb.next()) {
+                    subset_t m = 0;
+
+                    for (auto i: *c) {
+                        m |= subset_t(1) << i;
+                    }
+                    visited.insert(m);
+                }
+                EXPECT_EQ(visited, expected);
+            }
+
+            std::vector<subset_t> masks(MaskRange(n, k).begin(), MaskRange(n, k).end());
+            std::vector<subset_t> indices;
+
+            for (auto & c: IndexRange(n, k)) {
+                EXPECT_EQ(c.size(), k);
+                indices.push_back(c.mask());
+            }
+
+            EXPECT_TRUE(std::is_sorted(masks.begin(), masks.end()));
+            EXPECT_EQ(std::set<subset_t>(masks.begin(), masks.end()), expected);
+            EXPECT_EQ(std::set<subset_t>(indices.begin(), indices.end()), expected);
+            EXPECT_EQ(indices.size(), expected.size());
+        }
+    }
+
+    size_t count = 0;
+
+    for (auto m: MaskRange(32, 31)) {
+        EXPECT_EQ(__builtin_popcount(m), 31);
+        count++;
+    }
+    EXPECT_EQ(count, 32U);
+
+    EXPECT_THROW(MaskRange(33, 3), std::invalid_argument);
+    EXPECT_THROW(IndexRange(33, 3), std::invalid_argument);
+    EXPECT_THROW(IndexRange(9, 33), std::invalid_argument);
+}
+
+TEST(SubsetTest, TablesMatchMaskRange)
+{
+    using namespace sudoku;
+
+    EXPECT_EQ(subset::subsets(9, 0).size(), 1U);
+    EXPECT_EQ(subset::subsets(3, 4).size(), 0U);
+    EXPECT_THROW(subset::subsets(10, 2), std::invalid_argument);
+
+    for (size_t n = 0; n <= SUDOKU_NUMBERS; n++) {
+        for (size_t k = 0; k <= n; k++) {
+            std::vector<mask_t> masks;
+
+            for (auto m: combination::MaskRange(n, k)) {
+                masks.push_back(m);
+            }
+
+            auto range = subset::subsets(n, k);
+
+            EXPECT_EQ(std::vector<mask_t>(range.begin(), range.end()), masks);
+        }
+    }
+}
+
+TEST(PermutationTest, RankUnrank)
+{
+    using namespace sudoku::permutation;
+
+    // Same order as the allocating generator, which counts from 1.
+    for (size_t n = 1; n <= 5; n++) {
+        Permutation perm(n);
+        FixedPermutation p(n);
+        size_t count = 0;
+
+        while (auto v = perm.next()) {
+            for (size_t i = 0; i < n; i++) {
+                EXPECT_EQ(p[i] + 1U, (*v)[i]);
+            }
+            count++;
+
+            if (!p.next()) {
+                break;
+            }
+        }
+        EXPECT_EQ(count, factorial(n));
+    }
+
+    rank_t r = 0;
+
+    for_each(9, [&r](const FixedPermutation & p) {
+        ASSERT_EQ(p.rank(), r);
+
+        if (r % 997 == 0) {
+            EXPECT_EQ(FixedPermutation::unrank(9, r), p);
+            EXPECT_EQ(p.inverse().inverse(), p);
+        }
+        r++;
+    });
+    EXPECT_EQ(r, factorial(9));
+
+    EXPECT_NO_THROW(FixedPermutation p(MAX_LENGTH));
+    EXPECT_THROW(FixedPermutation p(MAX_LENGTH + 1), std::invalid_argument);
+    EXPECT_THROW(FixedPermutation::unrank(MAX_LENGTH + 1, 0), std::invalid_argument);
+}
+
+TEST(SudokuTest, InstrumentationReport)
+{
+    auto report = std::make_shared<sudoku::instrument::Report>();
+
+    for (auto str: { "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+                     "000000010400000000020000000000050407008000300001090000300400200050100000000806000" }) {
+        auto puzzle = sudoku::Solver(str);
+
+        puzzle.set_verbose(false);
+        puzzle.set_backtracking(true);
+        puzzle.set_report(report);
+        EXPECT_EQ(puzzle.solve(), sudoku::Status::Solved);
+    }
+
+    std::ostringstream json;
+    report->write_json(json);
+
+    EXPECT_NE(json.str().find("\"name\": \"Singles\""), std::string::npos);
+    ASSERT_EQ(report->get_batch().size(), 2U);
+
+    if (!sudoku::instrument::enabled) {
+        EXPECT_EQ(report->get_puzzles(), 0U);
+        EXPECT_EQ(report->get_batch()[0].calls, 0U);
+        return;
+    }
+
+    EXPECT_EQ(report->get_puzzles(), 2U);
+
+    for (auto & c: report->get_batch()) {
+        uint64_t total = 0;
+
+        for (auto n: c.latency.buckets) {
+            total += n;
+        }
+        EXPECT_GT(c.calls, 0U);
+        EXPECT_EQ(total, c.calls);
+        EXPECT_LE(c.hits, c.calls);
+    }
+}
+
+TEST(TraceTest, SampledSpans)
+{
+    sudoku::trace::clear();
+
+    {
+        auto puzzle = sudoku::Solver(
+            "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+            sudoku::Backend::DancingLinks);
+
+        puzzle.solve();
+    }
+
+    std::ostringstream unsampled;
+    sudoku::trace::write_chrome_json(unsampled);
+    EXPECT_EQ(unsampled.str().find("Solver::solve"), std::string::npos);
+
+    std::thread worker([]() {
+        sudoku::trace::Sample sample;
+        auto puzzle = sudoku::Solver(
+            "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+            sudoku::Backend::DancingLinks);
+
+        puzzle.solve();
+    });
+    worker.join();
+
+    std::ostringstream sampled;
+    sudoku::trace::write_chrome_json(sampled);
+
+    if (sudoku::trace::enabled) {
+        EXPECT_NE(sampled.str().find("\"name\": \"Solver::solve\", \"ph\": \"X\""),
+                  std::string::npos);
+        EXPECT_NE(sampled.str().find("DancingLinks::solve"), std::string::npos);
+    }
+    EXPECT_EQ(sampled.str().find("{\"traceEvents\": ["), 0U);
+}
+
+TEST(TraceTest, RingsReused)
+{
+    const char * names[] = { "TraceTest::first", "TraceTest::second", "TraceTest::third" };
+
+    for (auto name: names) {
+        std::thread worker([name]() {
+            sudoku::trace::record(name, 1000, 2000);
+        });
+        worker.join();
+    }
+
+    std::ostringstream json;
+    sudoku::trace::write_chrome_json(json);
+
+    // One after another, the threads all record to the same ring.
+    std::string tid;
+
+    for (auto name: names) {
+        auto pos = json.str().find(std::string("\"name\": \"") + name);
+
+        ASSERT_NE(pos, std::string::npos) << name;
+        pos = json.str().find("\"tid\": ", pos);
+
+        auto t = json.str().substr(pos, json.str().find(',', pos) - pos);
+
+        EXPECT_TRUE(tid.empty() || t == tid) << name;
+        tid = t;
+    }
+}
+
+TEST(AllocationTest, Combinatorics)
+{
+    using namespace sudoku;
+
+    size_t sum = 0;
+
+    EXPECT_NO_ALLOCATIONS(
+        for (size_t k = 0; k <= SUDOKU_NUMBERS; k++) {
+            for (auto m: combination::MaskRange(SUDOKU_NUMBERS, k)) {
+                sum += m;
+            }
+            for (auto & c: combination::IndexRange(SUDOKU_NUMBERS, k)) {
+                sum += c.mask();
+            }
+            for (auto m: subset::subsets(SUDOKU_NUMBERS, k)) {
+                sum += m;
+            }
+        });
+
+    EXPECT_NO_ALLOCATIONS(
+        permutation::for_each(SUDOKU_NUMBERS, [&sum](const permutation::FixedPermutation & p) {
+            sum += p[0];
+        }));
+
+    EXPECT_NO_ALLOCATIONS(
+        sum += permutation::FixedPermutation::unrank(SUDOKU_NUMBERS, 12345).inverse().rank());
+
+    // The generator these replace allocates for every combination.
+    combination::Combination comb(SUDOKU_NUMBERS, 3);
+    EXPECT_GT(test::count_allocations([&comb]() { while (comb.next()) {} }), 84U);
+
+    EXPECT_GT(sum, 0U);
+}
+
+TEST(AllocationTest, SolveWithEngines)
+{
+    using namespace sudoku;
+
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        "000000010400000000020000000000050407008000300001090000300400200050100000000806000"
+    };
+
+    // The fixed size engines allocate nothing once the thread has its
+    // engine, which the first puzzle creates.
+    for (auto backend: { Backend::Backtracking, Backend::DancingLinks, Backend::Bitboard }) {
+        Solver(puzzles[0], backend).solve();
+
+        for (auto str: puzzles) {
+            auto puzzle = Solver(str, backend);
+
+            EXPECT_NO_ALLOCATIONS(EXPECT_EQ(puzzle.solve(), Status::Solved));
+        }
+    }
+
+    // The clause database of the CDCL engine keeps its capacity once
+    // warmed up.
+    auto engine = engine::make_engine(Backend::Cdcl);
+    std::vector<grid_t> grids(3);
+
+    for (size_t i = 0; i < grids.size(); i++) {
+        parse_grid(puzzles[i], SUDOKU_GRID_LENGTH, grids[i]);
+        engine->solve(grids[i]);
+    }
+
+    for (auto & g: grids) {
+        EXPECT_NO_ALLOCATIONS(EXPECT_EQ(engine->solve(g), 1U));
+    }
+
+    // The logical eliminators still build cell vectors on every pass,
+    // but puzzles decided up front never reach them.
+    auto solved = Solver(
+        "534678912672195348198342567859761423426853791713924856961537284287419635345286179");
+    auto invalid = Solver(
+        "110000000000000000000000000000000000000000000000000000000000000000000000000000000");
+
+    EXPECT_NO_ALLOCATIONS(EXPECT_EQ(solved.solve(), Status::Solved));
+    EXPECT_NO_ALLOCATIONS(EXPECT_EQ(invalid.solve(), Status::Contradiction));
+}
+
+TEST(AllocationTest, LogicBudget)
+{
+    using namespace sudoku;
+
+    // The logical path is not allocation-free: the eliminators return
+    // cell vectors and build maps on every pass, and CellGetter copies
+    // the cells for each row, column and box.  These budgets are about a
+    // third over the counts with libstdc++, to catch it getting worse
+    // until that interface is reworked.
+    const char * str =
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000";
+
+    auto puzzle = Solver(str);
+    auto candidates = puzzle.get_candidates();
+    auto solved = puzzle.get_solved();
+
+    auto box = [](const Cell & c, index_t i) { return c.pos.box == i; };
+    auto column = [](const Cell & c, index_t i) { return c.pos.column == i; };
+    auto row = [](const Cell & c, index_t i) { return c.pos.row == i; };
+    CellGetter solvedgetters([&solved]() { return solved; }, box, column, row);
+    CellGetter candgetters([&candidates]() { return candidates; }, box, column, row);
+
+    eliminator::SimpleSingles simple;
+    eliminator::Singles singles;
+
+    EXPECT_LE(test::count_allocations([&]() { simple.eliminate(solvedgetters, candgetters); }),
+              330U);
+    EXPECT_LE(test::count_allocations([&]() { singles.eliminate(solvedgetters, candgetters); }),
+              1200U);
+    EXPECT_LE(test::count_allocations([&puzzle]() { puzzle.solve(); }), 5200U);
+}
+
+TEST(BatchTest, PackedRecords)
+{
+    using namespace sudoku;
+
+    std::string records =
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000"
+        "110000000000000000000000000000000000000000000000000000000000000000000000000000000"
+        "00004070050078002007000200681000790046000005100960007890080001008006400900205000x"
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400";
+    const size_t n = records.size() / RECORD_LENGTH;
+
+    for (auto backend: { Backend::Backtracking, Backend::DancingLinks,
+                         Backend::Bitboard, Backend::Cdcl }) {
+        std::string out(records.size(), ' ');
+        std::vector<Status> status(n);
+
+        EXPECT_EQ(solve_batch(records.data(), n, &out[0], status.data(), backend), 2U);
+
+        EXPECT_EQ(status[0], Status::Solved);
+        EXPECT_EQ(status[1], Status::Contradiction);
+        EXPECT_EQ(status[2], Status::Invalid);
+        EXPECT_EQ(status[3], Status::Solved);
+
+        for (size_t i = 0; i < n; i++) {
+            auto record = out.substr(i * RECORD_LENGTH, RECORD_LENGTH);
+
+            if (status[i] != Status::Solved) {
+                EXPECT_EQ(record, records.substr(i * RECORD_LENGTH, RECORD_LENGTH));
+                continue;
+            }
+
+            auto puzzle = Solver(record);
+            EXPECT_TRUE(puzzle.is_solved());
+
+            for (size_t j = 0; j < RECORD_LENGTH; j++) {
+                char given = records[i * RECORD_LENGTH + j];
+
+                EXPECT_TRUE(given == '0' || given == record[j]);
+            }
+        }
+    }
+
+    // In place, reusing one engine and without allocating.
+    BatchSolver solver;
+    std::string out = records;
+
+    EXPECT_NO_ALLOCATIONS(solver.solve_batch(&out[0], n, &out[0], nullptr));
+    EXPECT_EQ(out.substr(0, RECORD_LENGTH).find('0'), std::string::npos);
+
+    solver.get_limits().set_step_budget(1);
+    EXPECT_EQ(solver.solve(records.data() + 3 * RECORD_LENGTH, &out[0]), Status::TimedOut);
+
+    EXPECT_THROW(BatchSolver(Backend::Logic), std::invalid_argument);
+}
+
+TEST(BatchTest, ParallelMatchesSerial)
+{
+    using namespace sudoku;
+
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        "110000000000000000000000000000000000000000000000000000000000000000000000000000000",
+        "000000010400000000020000000000050407008000300001090000300400200050100000000806000",
+        "00004070050078002007000200681000790046000005100960007890080001008006400900205000x"
+    };
+    std::string records;
+
+    for (size_t i = 0; i < 203; i++) {
+        records += puzzles[(i * 7) % 5];
+    }
+
+    const size_t n = records.size() / RECORD_LENGTH;
+    std::string expected(records.size(), ' ');
+    std::vector<Status> expected_status(n);
+    size_t solved = BatchSolver().solve_batch(records.data(), n, &expected[0],
+                                              expected_status.data());
+
+    ParallelBatchSolver pool(Backend::Bitboard, 4);
+    EXPECT_EQ(pool.get_threads(), 4U);
+
+    for (size_t round = 0; round < 3; round++) {
+        std::string out(records.size(), ' ');
+        std::vector<Status> status(n);
+
+        EXPECT_EQ(pool.solve_batch(records.data(), n, &out[0], status.data()), solved);
+        EXPECT_EQ(out, expected);
+        EXPECT_EQ(status, expected_status);
+    }
+
+    // Fewer records than threads, and none.
+    std::string out(2 * RECORD_LENGTH, ' ');
+    EXPECT_EQ(pool.solve_batch(records.data(), 2, &out[0], nullptr), 1U);
+    EXPECT_EQ(out, expected.substr(0, 2 * RECORD_LENGTH));
+    EXPECT_EQ(pool.solve_batch(records.data(), 0, &out[0], nullptr), 0U);
+}
+
+TEST(CanonicalTest, Minlex)
+{
+    using namespace sudoku;
+
+    grid_t puzzle;
+    char str[SUDOKU_GRID_LENGTH + 1] = {};
+
+    ASSERT_TRUE(parse_grid("000000010400000000020000000000050407008000300001090000300400200050100000000806000",
+                           SUDOKU_GRID_LENGTH, puzzle));
+
+    // Swaps the first two bands, the columns of the last stack and
+    // digits 1 and 2, and transposes.
+    canonical::Transform variant;
+
+    variant.transpose = true;
+    variant.rows = {{ 3, 4, 5, 0, 1, 2, 6, 7, 8 }};
+    variant.columns = {{ 0, 1, 2, 3, 4, 5, 8, 6, 7 }};
+    std::swap(variant.digits[1], variant.digits[2]);
+
+    for (auto & g: { puzzle, variant.apply(puzzle) }) {
+        canonical::Transform transform;
+        auto form = canonical::canonicalize(g, transform);
+
+        format_grid(form, str);
+        EXPECT_STREQ(str, "000000001000000020000003000000040500006000300007810000010020004030000070950000000");
+        EXPECT_EQ(transform.apply(g), form);
+        EXPECT_EQ(transform.revert(form), g);
+    }
+}
+
+TEST(CacheTest, SymmetricVariants)
+{
+    using namespace sudoku;
+
+    grid_t puzzle, solution;
+
+    ASSERT_TRUE(parse_grid("000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+                           SUDOKU_GRID_LENGTH, puzzle));
+
+    auto engine = engine::make_engine(Backend::Bitboard);
+
+    ASSERT_EQ(engine->solve(puzzle), 1U);
+    solution = engine->get_solution();
+
+    // Transposed and with the digits rotated.
+    canonical::Transform variant;
+
+    variant.transpose = true;
+    for (index_t d = 1; d <= SUDOKU_NUMBERS; d++) {
+        variant.digits[d] = d % SUDOKU_NUMBERS + 1;
+    }
+
+    canonical::Transform t1, t2;
+    auto c1 = canonical::canonicalize(puzzle, t1);
+    auto c2 = canonical::canonicalize(variant.apply(puzzle), t2);
+
+    EXPECT_EQ(c1, c2);
+    EXPECT_EQ(t1.apply(puzzle), c1);
+    EXPECT_EQ(t1.revert(c1), puzzle);
+
+    SolutionCache cache(4, 2);
+    grid_t found;
+    bool unique;
+
+    EXPECT_FALSE(cache.lookup(puzzle, found, unique));
+    cache.insert(puzzle, solution, false);
+    cache.insert(puzzle, solution, true);
+    cache.insert(puzzle, solution, false);
+
+    ASSERT_TRUE(cache.lookup(variant.apply(puzzle), found, unique));
+    EXPECT_TRUE(unique);
+    EXPECT_EQ(found, variant.apply(solution));
+    EXPECT_EQ(cache.get_hits(), 1U);
+    EXPECT_EQ(cache.get_misses(), 1U);
+
+    // Least recently used entries go first.  Puzzles with different
+    // numbers of givens are not equivalent.
+    for (index_t i = 0; i < 8; i++) {
+        grid_t other = {};
+
+        for (index_t j = 0; j <= i; j++) {
+            other[j] = j + 1;
+        }
+        cache.insert(other, other, true);
+    }
+
+    EXPECT_LE(cache.size(), 4U);
+    EXPECT_FALSE(cache.lookup(puzzle, found, unique));
+}
+
+TEST(CacheTest, SolverHits)
+{
+    using namespace sudoku;
+
+    std::string puzzle("000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+    std::string transposed(puzzle);
+
+    for (size_t r = 0; r < SUDOKU_NUMBERS; r++) {
+        for (size_t c = 0; c < SUDOKU_NUMBERS; c++) {
+            transposed[c * SUDOKU_NUMBERS + r] = puzzle[r * SUDOKU_NUMBERS + c];
+        }
+    }
+
+    auto cache = std::make_shared<SolutionCache>(16);
+    Solver first(puzzle, Backend::DancingLinks);
+    Solver second(transposed, Backend::Logic);
+
+    first.set_cache(cache);
+    second.set_cache(cache);
+
+    EXPECT_EQ(first.solve(), Status::Solved);
+    EXPECT_EQ(second.solve(), Status::Solved);
+    EXPECT_EQ(second.get_passes(), 0U);
+    EXPECT_EQ(cache->get_hits(), 1U);
+
+    BatchSolver batch;
+    std::string out(RECORD_LENGTH, ' ');
+
+    batch.set_cache(cache);
+    EXPECT_EQ(batch.solve(transposed.data(), &out[0]), Status::Solved);
+    EXPECT_EQ(cache->get_hits(), 2U);
+}
+
+TEST(StoreTest, SharedAcrossOpens)
+{
+    using namespace sudoku;
+
+    char dir[] = "/tmp/sudoku_storeXXXXXX";
+
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+
+    std::string path = std::string(dir) + "/solutions";
+    std::string puzzle("000040700500780020070002006810007900460000051009600078900800010080064009002050000");
+    std::string other("800000000003600000070090200050007000000045700000100030001000068008500010090000400");
+    std::string out(RECORD_LENGTH, ' ');
+
+    auto writer = std::make_shared<SolutionStore>();
+    SolutionStore reader;
+
+    EXPECT_FALSE(reader.open(path));
+    ASSERT_TRUE(writer->open_writable(path, 16));
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(writer->get_capacity(), 1024U);
+
+    BatchSolver batch;
+
+    batch.set_store(writer);
+    EXPECT_EQ(batch.solve(puzzle.data(), &out[0]), Status::Solved);
+    EXPECT_EQ(batch.solve(other.data(), &out[0]), Status::Solved);
+    EXPECT_EQ(reader.size(), 2U);
+
+    grid_t values;
+    SolutionStore::Record record;
+
+    ASSERT_TRUE(parse_grid(other.data(), other.size(), values));
+    ASSERT_TRUE(reader.lookup(values, record));
+    EXPECT_EQ(record.backend, Backend::Bitboard);
+    EXPECT_GT(record.steps, 0U);
+    EXPECT_FALSE(reader.insert(values, record));
+
+    std::string solution(RECORD_LENGTH, ' ');
+
+    format_grid(record.solution, &solution[0]);
+    EXPECT_EQ(solution, out);
+
+    // The reader finds a relabeled variant, and so does a batch
+    // solver that would otherwise run out of steps.
+    for (auto & v: values) {
+        v = v == 0 ? 0 : v % SUDOKU_NUMBERS + 1;
+    }
+
+    ASSERT_TRUE(reader.lookup(values, record));
+
+    format_grid(values, &other[0]);
+    batch.set_store(std::make_shared<SolutionStore>());
+    batch.get_limits().set_step_budget(1);
+    EXPECT_EQ(batch.solve(other.data(), &out[0]), Status::TimedOut);
+
+    auto shared = std::make_shared<SolutionStore>();
+
+    ASSERT_TRUE(shared->open(path));
+    batch.set_store(shared);
+    EXPECT_EQ(batch.solve(other.data(), &out[0]), Status::Solved);
+
+    // One writer at a time; the lock is per open file, so a second
+    // writer in the same process is refused too.
+    SolutionStore second;
+
+    EXPECT_FALSE(second.open_writable(path, 16));
+    EXPECT_NE(second.get_error().find("locked"), std::string::npos);
+
+    writer.reset();
+    ASSERT_TRUE(second.open_writable(path, 16));
+    EXPECT_EQ(second.size(), 2U);
+
+    unlink(path.c_str());
+    rmdir(dir);
+}
+
+TEST(PackedTest, RoundTripAndSolve)
+{
+    using namespace sudoku;
+
+    std::string records =
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000"
+        "8..........36......7..9.2...5...7.......457.....1...3...1....68..85...1..9....4.."
+        "00000001040000000002000000000050407008000300001090000300400200050100000000806000x";
+    std::vector<uint8_t> file(packed::file_size(3));
+    packed::Writer writer(file.data(), 3);
+
+    EXPECT_EQ(packed::PACKED_LENGTH, 41U);
+    EXPECT_EQ(writer.set_batch(0, 3, records.data()), 1U);
+
+    packed::Reader reader(file.data(), file.size());
+    std::string record(RECORD_LENGTH, ' ');
+
+    ASSERT_EQ(reader.size(), 3U);
+    reader.get(2, &record[0]);
+    EXPECT_EQ(record, std::string(RECORD_LENGTH, '?'));
+    reader.get(1, &record[0]);
+    EXPECT_EQ(record, "800000000003600000070090200050007000000045700000100030001000068008500010090000400");
+
+    EXPECT_THROW(packed::Reader(file.data(), file.size() - 1), std::invalid_argument);
+    EXPECT_THROW(packed::Reader(records.data(), records.size()), std::invalid_argument);
+
+    BatchSolver solver;
+    Status status[3];
+    std::string expected(records);
+
+    size_t solved = solver.solve_batch(records.data(), 3, &expected[0], nullptr);
+
+    EXPECT_EQ(packed::solve_batch(solver, reader, 0, 3, writer, status), solved);
+    EXPECT_EQ(status[2], Status::Invalid);
+
+    EXPECT_EQ(solved, 2U);
+
+    for (size_t i = 0; i < 2; i++) {
+        reader.get(i, &record[0]);
+        EXPECT_EQ(record, expected.substr(i * RECORD_LENGTH, RECORD_LENGTH));
+    }
+}
+
+TEST(QueueTest, ManyProducersAndConsumers)
+{
+    sudoku::queue::BoundedQueue<size_t> queue(8);
+    std::atomic<size_t> sum(0);
+    std::vector<std::thread> threads;
+
+    EXPECT_THROW(sudoku::queue::BoundedQueue<size_t>(6), std::invalid_argument);
+
+    for (size_t t = 0; t < 3; t++) {
+        threads.push_back(std::thread([&queue, t]() {
+            for (size_t i = 1; i <= 1000; i++) {
+                queue.push(t * 1000 + i);
+            }
+        }));
+        threads.push_back(std::thread([&queue, &sum]() {
+            for (size_t i = 0; i < 1000; i++) {
+                sum += queue.pop();
+            }
+        }));
+    }
+
+    for (auto & t: threads) {
+        t.join();
+    }
+
+    size_t value;
+    EXPECT_FALSE(queue.try_pop(value));
+    EXPECT_EQ(sum, 3000U * 3001U / 2);
+}
+
+TEST(PipelineTest, StreamsInInputOrder)
+{
+    using namespace sudoku;
+
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400\r",
+        "110000000000000000000000000000000000000000000000000000000000000000000000000000000",
+        "0000000104000000000200000000000504070080003000010900003004002000501000000008060001",
+        "not a puzzle"
+    };
+    std::string input;
+    std::string expected;
+
+    for (size_t i = 0; i < 100; i++) {
+        std::string line = puzzles[(i * 3) % 5];
+        std::string record = line.substr(0, line.find('\r'));
+
+        input += line + "\n";
+
+        if (record.size() != RECORD_LENGTH) {
+            record = std::string(RECORD_LENGTH, '?');
+        }
+
+        std::string out(RECORD_LENGTH, ' ');
+        BatchSolver().solve(record.data(), &out[0]);
+        expected += out + "\n";
+    }
+
+    // The last line without a newline.
+    input += puzzles[0];
+    expected += expected.substr(0, RECORD_LENGTH + 1);
+
+    FILE * in = std::tmpfile();
+    FILE * out = std::tmpfile();
+
+    ASSERT_TRUE(in != nullptr && out != nullptr);
+    std::fwrite(input.data(), 1, input.size(), in);
+    std::rewind(in);
+
+    Pipeline pipeline(Backend::Bitboard, 3, 4);
+
+    EXPECT_TRUE(pipeline.run(fileno(in), fileno(out)));
+    EXPECT_EQ(pipeline.get_count(Status::Solved), 41U);
+    EXPECT_EQ(pipeline.get_count(Status::Contradiction), 20U);
+    EXPECT_EQ(pipeline.get_count(Status::Invalid), 40U);
+
+    std::string result(expected.size() + 1, ' ');
+    std::rewind(out);
+    result.resize(std::fread(&result[0], 1, result.size(), out));
+    EXPECT_EQ(result, expected);
+
+    std::fclose(in);
+    std::fclose(out);
+}
+
+TEST(PipelineTest, WriteFailureStopsReader)
+{
+    using namespace sudoku;
+
+    std::string input;
+
+    for (size_t i = 0; i < 8; i++) {
+        input += "000040700500780020070002006810007900460000051009600078900800010080064009002050000\n";
+    }
+
+    // The input stays open, and nobody reads the output.
+    int in[2];
+    int out[2];
+
+    ASSERT_EQ(pipe(in), 0);
+    ASSERT_EQ(pipe(out), 0);
+    ASSERT_EQ(write(in[1], input.data(), input.size()), static_cast<ssize_t>(input.size()));
+    close(out[0]);
+
+    auto handler = std::signal(SIGPIPE, SIG_IGN);
+    Pipeline pipeline(Backend::Bitboard, 2, 4);
+
+    EXPECT_FALSE(pipeline.run(in[0], out[1]));
+    EXPECT_EQ(errno, EPIPE);
+
+    std::signal(SIGPIPE, handler);
+    close(in[0]);
+    close(in[1]);
+    close(out[1]);
+}
+
+TEST(ServerTest, PipelinedRequests)
+{
+    using namespace sudoku;
+
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        "110000000000000000000000000000000000000000000000000000000000000000000000000000000",
+        "not a puzzle"
+    };
+    std::string input;
+    std::string expected;
+    std::vector<Status> statuses;
+
+    for (size_t i = 0; i < 1500; i++) {
+        std::string record = puzzles[(i * 3) % 4];
+        std::string out(RECORD_LENGTH, ' ');
+
+        if (record.size() != RECORD_LENGTH) {
+            record = std::string(RECORD_LENGTH, '?');
+        }
+
+        statuses.push_back(BatchSolver().solve(record.data(), &out[0]));
+        input += record;
+        expected += out;
+    }
+
+    char dir[] = "/tmp/sudoku_serverXXXXXX";
+
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+
+    std::string path = std::string(dir) + "/socket";
+    Server server(Backend::Bitboard, 2, 8);
+
+    ASSERT_TRUE(server.listen(path));
+
+    std::thread thread([&server]() {
+        EXPECT_TRUE(server.run());
+    });
+
+    Client batch;
+    Client single;
+
+    ASSERT_TRUE(batch.connect(path));
+    ASSERT_TRUE(single.connect(path));
+
+    // Both requests are sent before either response is read.
+    Client::Response responses[2];
+
+    EXPECT_TRUE(single.send_solve(7, input.data(), 1));
+    EXPECT_TRUE(single.send_solve(8, input.data() + RECORD_LENGTH, 2));
+
+    std::string result(input.size(), ' ');
+    std::vector<Status> status(statuses.size());
+
+    EXPECT_TRUE(batch.solve_batch(input.data(), statuses.size(), &result[0], status.data()));
+    EXPECT_EQ(result, expected);
+    EXPECT_EQ(status, statuses);
+
+    EXPECT_TRUE(single.receive(responses[0]));
+    EXPECT_TRUE(single.receive(responses[1]));
+
+    if (responses[0].header.id == 8) {
+        std::swap(responses[0], responses[1]);
+    }
+
+    EXPECT_EQ(responses[0].header.id, 7U);
+    EXPECT_EQ(std::string(responses[0].records.data(), RECORD_LENGTH), expected.substr(0, RECORD_LENGTH));
+    EXPECT_EQ(responses[1].header.count, 2U);
+    EXPECT_EQ(std::string(responses[1].records.data(), 2 * RECORD_LENGTH),
+              expected.substr(RECORD_LENGTH, 2 * RECORD_LENGTH));
+    EXPECT_EQ(responses[1].status[1], statuses[2]);
+
+    protocol::Metrics metrics;
+
+    EXPECT_TRUE(single.get_metrics(metrics));
+    EXPECT_EQ(metrics.threads, 2U);
+    EXPECT_EQ(metrics.connections, 2U);
+    EXPECT_EQ(metrics.puzzles, statuses.size() + 3);
+    EXPECT_EQ(metrics.queue_depth, 0U);
+    EXPECT_GE(metrics.batches, metrics.puzzles / 8);
+    EXPECT_LE(metrics.latency_p50, metrics.latency_p99);
+    EXPECT_LE(metrics.latency_p99, metrics.latency_max);
+    EXPECT_GT(metrics.latency_max, 0U);
+
+    server.stop();
+    thread.join();
+
+    rmdir(dir);
+}
+
+TEST(ServerTest, RequestsWaitForBatches)
+{
+    using namespace sudoku;
+
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        "110000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    };
+    std::string input;
+    std::string expected;
+
+    for (size_t i = 0; i < 300; i++) {
+        std::string out(RECORD_LENGTH, ' ');
+
+        BatchSolver().solve(puzzles[i % 3], &out[0]);
+        input += puzzles[i % 3];
+        expected += out;
+    }
+
+    char dir[] = "/tmp/sudoku_serverXXXXXX";
+
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+
+    std::string path = std::string(dir) + "/socket";
+    // Four batches of two puzzles.
+    Server server(Backend::Bitboard, 1, 2);
+
+    ASSERT_TRUE(server.listen(path));
+
+    std::thread thread([&server]() {
+        EXPECT_TRUE(server.run());
+    });
+
+    Client client;
+    Client other;
+
+    ASSERT_TRUE(client.connect(path));
+    ASSERT_TRUE(other.connect(path));
+
+    // The requests after the first one wait with it for batches, while
+    // the other connection is served.
+    EXPECT_TRUE(client.send_solve(1, input.data(), 300));
+    EXPECT_TRUE(client.send_metrics(2));
+    EXPECT_TRUE(client.send_solve(3, input.data() + RECORD_LENGTH, 1));
+
+    protocol::Metrics metrics;
+
+    EXPECT_TRUE(other.get_metrics(metrics));
+
+    Client::Response responses[3];
+
+    for (size_t i = 0; i < 3; i++) {
+        Client::Response response;
+
+        ASSERT_TRUE(client.receive(response));
+        ASSERT_TRUE(response.header.id >= 1 && response.header.id <= 3);
+        responses[response.header.id - 1] = response;
+    }
+
+    EXPECT_EQ(std::string(responses[0].records.data(), responses[0].records.size()), expected);
+    EXPECT_EQ(responses[1].header.type, protocol::Type::Metrics);
+    EXPECT_EQ(std::string(responses[2].records.data(), RECORD_LENGTH),
+              expected.substr(RECORD_LENGTH, RECORD_LENGTH));
+
+    EXPECT_TRUE(other.get_metrics(metrics));
+    EXPECT_EQ(metrics.puzzles, 301U);
+    EXPECT_EQ(metrics.queue_depth, 0U);
+
+    server.stop();
+    thread.join();
+
+    rmdir(dir);
+}
+
+TEST(BacktrackTest, CountSolutions)
+{
+    sudoku::backtrack::Backtracker bt;
+    sudoku::grid_t grid;
+
+    grid.fill(0);
+    EXPECT_EQ(bt.solve(grid, 2), 2U);
+
+    grid[0] = 1;
+    grid[1] = 1;
+    EXPECT_EQ(bt.solve(grid, 2), 0U);
+}
+
+TEST(SudokuTest, SolveDancingLinks)
+{
+    auto puzzle = sudoku::Solver(
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        sudoku::Backend::DancingLinks);
+
+    puzzle.solve();
+
+    EXPECT_EQ(puzzle.get_candidates().size(), 0U);
+    EXPECT_TRUE(valid_solution(puzzle.get_solved()));
+    EXPECT_EQ(puzzle.get_solution_count(), 1U);
+}
+
+TEST(DancingLinksTest, CrossCheckBacktracking)
+{
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        "000000010400000000020000000000050407008000300001090000300400200050100000000806000",
+    };
+
+    sudoku::dlx::DancingLinks dlx;
+    sudoku::backtrack::Backtracker bt;
+
+    for (auto str: puzzles) {
+        sudoku::grid_t grid;
+
+        for (size_t i = 0; i < grid.size(); i++) {
+            grid[i] = str[i] - '0';
+        }
+
+        EXPECT_EQ(dlx.solve(grid), 1U) << str;
+        EXPECT_EQ(bt.solve(grid), 1U) << str;
+        EXPECT_EQ(dlx.get_solution(), bt.get_solution()) << str;
+    }
+
+    sudoku::grid_t grid;
+
+    grid.fill(0);
+    EXPECT_EQ(dlx.solve(grid, 5), 5U);
+
+    grid[0] = 1;
+    grid[80] = 1;
+    grid[8] = 1;
+    EXPECT_EQ(dlx.solve(grid), 0U);
+
+    grid[8] = 0;
+    EXPECT_EQ(dlx.solve(grid, 3), 3U);
+}
+
+TEST(BitboardTest, CrossCheckDancingLinks)
+{
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        "4.....8.5.3..........7......2.....6.....8.4......1.......6.3.7.5..2.....1.4......",
+        "000000010400000000020000000000050407008000300001090000300400200050100000000806000",
+    };
+
+    sudoku::bitboard::BandEngine bb;
+    sudoku::dlx::DancingLinks dlx;
+
+    for (auto str: puzzles) {
+        sudoku::grid_t grid;
+
+        ASSERT_TRUE(sudoku::parse_grid(str, 81, grid)) << str;
+        EXPECT_EQ(bb.solve(grid), 1U) << str;
+        EXPECT_EQ(dlx.solve(grid), 1U) << str;
+        EXPECT_EQ(bb.get_solution(), dlx.get_solution()) << str;
+
+        char out[82] = { 0 };
+        sudoku::format_grid(bb.get_solution(), out);
+
+        sudoku::grid_t roundtrip;
+        EXPECT_TRUE(sudoku::parse_grid(out, 81, roundtrip));
+        EXPECT_EQ(roundtrip, bb.get_solution());
+    }
+
+    sudoku::grid_t grid;
+
+    grid.fill(0);
+    EXPECT_EQ(bb.solve(grid, 4), 4U);
+
+    grid[0] = 5;
+    grid[10] = 5;
+    EXPECT_EQ(bb.solve(grid), 0U);
+}
+
+TEST(CdclTest, CrossCheckDancingLinks)
+{
+    const char * puzzles[] = {
+        "000040700500780020070002006810007900460000051009600078900800010080064009002050000",
+        "800000000003600000070090200050007000000045700000100030001000068008500010090000400",
+        "4.....8.5.3..........7......2.....6.....8.4......1.......6.3.7.5..2.....1.4......",
+        "000000010400000000020000000000050407008000300001090000300400200050100000000806000",
+    };
+
+    sudoku::cdcl::CdclEngine cdcl;
+    sudoku::dlx::DancingLinks dlx;
+
+    for (auto str: puzzles) {
+        sudoku::grid_t grid;
+
+        ASSERT_TRUE(sudoku::parse_grid(str, 81, grid)) << str;
+        EXPECT_EQ(cdcl.solve(grid), 1U) << str;
+        EXPECT_EQ(dlx.solve(grid), 1U) << str;
+        EXPECT_EQ(cdcl.get_solution(), dlx.get_solution()) << str;
+    }
+
+    sudoku::grid_t grid;
+
+    grid.fill(0);
+    EXPECT_EQ(cdcl.solve(grid, 3), 3U);
+
+    grid[0] = 7;
+    grid[40] = 7;
+    grid[80] = 7;
+    EXPECT_EQ(cdcl.solve(grid), 2U);
+
+    grid[76] = 7;
+    EXPECT_EQ(cdcl.solve(grid), 0U);
+}
+
+TEST(SudokuTest, InvalidCharacter)
+{
+    EXPECT_THROW(sudoku::Solver(
+        "00004070050078002007000200681000790046000005100960007890080001008006400900205000x"),
+                 std::invalid_argument);
+}
+
 int main(int argc, char *argv[])
 {
     testing::InitGoogleTest(&argc, argv);
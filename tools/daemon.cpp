@@ -0,0 +1,196 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include <unistd.h>
+
+#include "sudokucpp/client.h"
+#include "sudokucpp/server.h"
+#include "options.h"
+
+using namespace sudoku;
+
+namespace {
+    // Slots of a store created by -S.
+    const size_t STORE_SLOTS = 1 << 22;
+
+    Server * server = nullptr;
+
+    void
+    usage(
+        const char * name)
+    {
+        std::fprintf(stderr,
+                     "Usage: %s [-j threads] [-b backend] [-n steps] [-c entries]\n"
+                     "          [-s store | -S store] [-r records] [-l microseconds] socket\n"
+                     "       %s -m socket\n"
+                     "\n"
+                     "Solves the puzzles of requests on a Unix domain socket until\n"
+                     "SIGINT or SIGTERM.  Requests that come in while every solver\n"
+                     "thread is busy are solved together in batches.  With -m, prints\n"
+                     "the metrics of a running daemon.\n"
+                     "\n"
+                     "  -j threads       solver threads, one per hardware thread by default\n"
+                     "  -b backend       backtracking, dlx, bitboard (default) or cdcl\n"
+                     "  -n steps         search step budget per puzzle\n"
+                     "  -c entries       cache the solutions of puzzles and their symmetric\n"
+                     "                   variants\n"
+                     "  -s store         look puzzles up in a solution store\n"
+                     "  -S store         look up and add solutions, creating the store if needed\n"
+                     "  -r records       puzzles per batch, 256 by default\n"
+                     "  -l microseconds  longest wait for a batch to fill, 200 by default\n",
+                     name, name);
+    }
+
+    void
+    handle_signal(int)
+    {
+        server->stop();
+    }
+
+    int
+    print_metrics(
+        const char * path)
+    {
+        Client client;
+        protocol::Metrics m;
+
+        if (!client.connect(path) || !client.get_metrics(m)) {
+            std::fprintf(stderr, "%s\n", client.get_error().c_str());
+            return 1;
+        }
+
+        const struct {
+            const char * name;
+            uint64_t value;
+        } values[] = {
+            { "uptime_ns", m.uptime },
+            { "threads", m.threads },
+            { "connections", m.connections },
+            { "requests", m.requests },
+            { "batches", m.batches },
+            { "puzzles", m.puzzles },
+            { "solved", m.solved },
+            { "puzzles_per_second", m.puzzles_per_second },
+            { "queue_depth", m.queue_depth },
+            { "latency_p50_ns", m.latency_p50 },
+            { "latency_p90_ns", m.latency_p90 },
+            { "latency_p99_ns", m.latency_p99 },
+            { "latency_p999_ns", m.latency_p999 },
+            { "latency_max_ns", m.latency_max }
+        };
+
+        for (auto & v: values) {
+            std::printf("%s %llu\n", v.name, static_cast<unsigned long long>(v.value));
+        }
+
+        return 0;
+    }
+}
+
+int
+main(
+    int argc,
+    char ** argv)
+{
+    size_t threads = 0;
+    size_t steps = 0;
+    size_t records = 256;
+    long linger = 200;
+    std::shared_ptr<SolutionCache> cache;
+    std::shared_ptr<SolutionStore> store;
+    Backend backend = Backend::Bitboard;
+    bool metrics = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:b:n:c:s:S:r:l:m")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'b':
+            if (!parse_backend(optarg, backend)) {
+                std::fprintf(stderr, "Unknown backend %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            steps = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'c':
+            cache = std::make_shared<SolutionCache>(std::strtoul(optarg, nullptr, 10));
+            break;
+        case 's':
+        case 'S':
+            store = std::make_shared<SolutionStore>();
+
+            if (opt == 's' ? !store->open(optarg) : !store->open_writable(optarg, STORE_SLOTS)) {
+                std::fprintf(stderr, "%s: %s\n", optarg, store->get_error().c_str());
+                return 1;
+            }
+            break;
+        case 'r':
+            records = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'l':
+            linger = std::strtol(optarg, nullptr, 10);
+            break;
+        case 'm':
+            metrics = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (metrics) {
+        return print_metrics(argv[optind]);
+    }
+
+    Server daemon(backend, threads, records);
+
+    daemon.set_step_budget(steps);
+    daemon.set_linger(std::chrono::microseconds(linger));
+    daemon.set_cache(cache);
+    daemon.set_store(store);
+
+    if (!daemon.listen(argv[optind])) {
+        std::fprintf(stderr, "%s\n", daemon.get_error().c_str());
+        return 1;
+    }
+
+    server = &daemon;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (!daemon.run()) {
+        std::fprintf(stderr, "%s\n", daemon.get_error().c_str());
+        return 1;
+    }
+
+    return 0;
+}
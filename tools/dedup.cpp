@@ -0,0 +1,668 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sudokucpp/canonical.h"
+#include "sudokucpp/grid.h"
+#include "sudokucpp/mapped_file.h"
+#include "sudokucpp/packed.h"
+#include "lines.h"
+
+using namespace sudoku;
+
+namespace {
+    // A puzzle in canonical form and where its line or record starts,
+    // standing for count puzzles of the same form from there on.
+    struct Entry {
+        uint8_t form[packed::PACKED_LENGTH];
+        uint64_t offset;
+        uint64_t count;
+
+        bool operator<(const Entry & other) const {
+            int cmp = std::memcmp(this->form, other.form, sizeof(this->form));
+
+            return cmp < 0 || (cmp == 0 && this->offset < other.offset);
+        }
+    };
+
+    // Class sizes 1, 2, 3-4, 5-8, ...
+    const size_t BUCKETS = 40;
+
+    // At most this many partitions, a file descriptor each, to stay
+    // within the usual limit of 1024.
+    const size_t MAX_PARTITIONS = 768;
+
+    // Entries read at a time from each partition when merging.
+    const size_t MERGE_ENTRIES = 256;
+
+    // Sorts entries and keeps the first entry of each form, with the
+    // counts of the others added to it.
+    void
+    collapse(
+        std::vector<Entry> & entries)
+    {
+        size_t kept = 0;
+
+        std::sort(entries.begin(), entries.end());
+
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (kept > 0 && std::memcmp(entries[kept - 1].form, entries[i].form,
+                                        sizeof(entries[i].form)) == 0) {
+                entries[kept - 1].count += entries[i].count;
+            } else {
+                entries[kept++] = entries[i];
+            }
+        }
+
+        entries.resize(kept);
+    }
+
+    void
+    usage(
+        const char * name)
+    {
+        std::fprintf(stderr,
+                     "Usage: %s [-j threads] [-m megabytes] [-t directory] [-c] [-q]\n"
+                     "          input [output]\n"
+                     "\n"
+                     "Writes the first puzzle of each equivalence class of a file of\n"
+                     "puzzles, one per line or packed, in input order.  Puzzles are\n"
+                     "equivalent when they have the same minlex form.  The canonical\n"
+                     "forms are partitioned by hash to temporary files, and each\n"
+                     "partition deduplicated in memory.\n"
+                     "\n"
+                     "  -j threads    one per hardware thread by default\n"
+                     "  -m megabytes  memory for the partitions, 1024 by default\n"
+                     "  -t directory  for the temporary files, $TMPDIR or /tmp by default\n"
+                     "  -c            write the canonical forms instead\n"
+                     "  -q            no summary on stderr\n",
+                     name);
+    }
+
+    // An unlinked temporary file, removed when it is closed.
+    int
+    temp_file(
+        const std::string & directory)
+    {
+        std::string path = directory + "/sudokucpp-dedup.XXXXXX";
+        int fd = mkstemp(&path[0]);
+
+        if (fd >= 0) {
+            unlink(path.c_str());
+        }
+
+        return fd;
+    }
+
+    // The entries of a partition, and once it is deduplicated the
+    // first entry of each class by offset in the same file.  Entries
+    // stand for puzzles in all.
+    struct Partition {
+        std::mutex mutex;
+        int fd;
+        uint64_t entries;
+        uint64_t puzzles;
+        uint64_t kept;
+
+        Partition() : fd(-1), entries(0), puzzles(0), kept(0) {}
+
+        ~Partition() {
+            if (this->fd >= 0) {
+                close(this->fd);
+            }
+        }
+    };
+
+    class Dedup
+    {
+    public:
+        Dedup(const MappedFile & input, size_t threads)
+            : input(input), threads(threads), malformed(0), failed(false) {
+            for (auto & b: this->classes) {
+                b = 0;
+            }
+        }
+
+        bool open(size_t partitions, const std::string & directory);
+        void partition();
+        void deduplicate(size_t threads, uint64_t share);
+        bool merge(int out, bool canonical);
+        void summary() const;
+
+        bool is_failed() const {
+            return this->failed;
+        }
+
+    private:
+        bool read_record(uint64_t & offset, const char * & p, char * record) const;
+        void canonicalize(size_t thread, size_t flush);
+        bool deduplicate(Partition & partition, size_t chunk);
+        void append(Partition & partition, const std::vector<Entry> & entries);
+
+        const MappedFile & input;
+        std::unique_ptr<packed::Reader> reader;
+        size_t threads;
+        std::vector<std::unique_ptr<Partition>> partitions;
+        std::atomic<uint64_t> malformed;
+        std::atomic<uint64_t> classes[BUCKETS];
+        std::atomic<bool> failed;
+    };
+
+    bool
+    Dedup::open(
+        size_t partitions,
+        const std::string & directory)
+    {
+        if (packed::is_packed(this->input.get_data(), this->input.size())) {
+            try {
+                this->reader.reset(new packed::Reader(this->input.get_data(),
+                                                      this->input.size()));
+            } catch (const std::invalid_argument & e) {
+                std::fprintf(stderr, "%s\n", e.what());
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < partitions; i++) {
+            this->partitions.emplace_back(new Partition());
+            this->partitions[i]->fd = temp_file(directory);
+
+            if (this->partitions[i]->fd < 0) {
+                std::perror(directory.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void
+    Dedup::append(
+        Partition & partition,
+        const std::vector<Entry> & entries)
+    {
+        std::lock_guard<std::mutex> lock(partition.mutex);
+
+        if (!write_all(partition.fd, reinterpret_cast<const char *>(entries.data()),
+                       entries.size() * sizeof(Entry))) {
+            std::perror("write");
+            this->failed = true;
+        }
+
+        partition.entries += entries.size();
+
+        for (auto & e: entries) {
+            partition.puzzles += e.count;
+        }
+    }
+
+    // Canonicalizes the lines or records that start in the share of a
+    // thread, and appends them to the partitions by hash.  A full
+    // buffer drops repeated forms first, and is only appended while
+    // that leaves it over half full, so that many isomorphs of a few
+    // puzzles do not fill their partitions.
+    void
+    Dedup::canonicalize(
+        size_t thread,
+        size_t flush)
+    {
+        size_t n = this->partitions.size();
+        std::vector<std::vector<Entry>> buffers(n);
+        char record[RECORD_LENGTH];
+        char form[RECORD_LENGTH];
+        uint64_t first, last;
+
+        if (this->reader) {
+            first = this->reader->size() * thread / this->threads;
+            last = this->reader->size() * (thread + 1) / this->threads;
+        } else {
+            const char * data = this->input.get_data();
+            const char * end = data + this->input.size();
+
+            // Lines that start in the byte range of the thread.
+            auto start = [&](size_t t) {
+                const char * p = data + this->input.size() * t / this->threads;
+
+                if (p > data && p < end && p[-1] != '\n') {
+                    p = static_cast<const char *>(std::memchr(p, '\n', end - p));
+                    p = p != nullptr ? p + 1 : end;
+                }
+
+                return static_cast<uint64_t>(p - data);
+            };
+
+            first = start(thread);
+            last = start(thread + 1);
+        }
+
+        for (auto & b: buffers) {
+            b.reserve(flush);
+        }
+
+        const char * p = this->input.get_data() + first;
+
+        for (uint64_t offset = first; offset < last && !this->failed; ) {
+            Entry entry;
+            grid_t grid;
+            canonical::Transform transform;
+
+            entry.offset = offset;
+            entry.count = 1;
+
+            if (!read_record(offset, p, record)
+                || !parse_grid(record, RECORD_LENGTH, grid)) {
+                this->malformed++;
+                continue;
+            }
+
+            auto key = canonical::canonicalize(grid, transform);
+            auto hash = canonical::hash(key);
+            auto & buffer = buffers[((hash >> 32) * n) >> 32];
+
+            format_grid(key, form);
+            packed::pack(form, entry.form);
+            buffer.push_back(entry);
+
+            if (buffer.size() == flush) {
+                collapse(buffer);
+
+                if (buffer.size() > flush / 2) {
+                    append(*this->partitions[&buffer - buffers.data()], buffer);
+                    buffer.clear();
+                }
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (!buffers[i].empty()) {
+                collapse(buffers[i]);
+                append(*this->partitions[i], buffers[i]);
+            }
+        }
+    }
+
+    // The record at offset, a line or a packed record, and the offset
+    // of the next one.
+    bool
+    Dedup::read_record(
+        uint64_t & offset,
+        const char * & p,
+        char * record) const
+    {
+        if (this->reader) {
+            this->reader->get(offset++, record);
+            return true;
+        }
+
+        const char * end = this->input.get_data() + this->input.size();
+        const char * next = pack_line(p, end, record);
+
+        offset += next - p;
+        p = next;
+
+        return record[0] != '?';
+    }
+
+    void
+    Dedup::partition()
+    {
+        size_t n = this->partitions.size();
+        // Each thread buffers up to about 64k entries in all.
+        size_t flush = std::max<size_t>(16, std::min<size_t>(4096, 65536 / n));
+        std::vector<std::thread> workers;
+
+        for (size_t t = 0; t < this->threads; t++) {
+            workers.push_back(std::thread(&Dedup::canonicalize, this, t, flush));
+        }
+
+        for (auto & w: workers) {
+            w.join();
+        }
+    }
+
+    // Sorts a partition by canonical form and keeps the first entry of
+    // each class.  The partition is read chunk entries at a time, and
+    // repeated forms dropped whenever the entries held have doubled, so
+    // that memory follows the number of classes rather than puzzles.
+    bool
+    Dedup::deduplicate(
+        Partition & partition,
+        size_t chunk)
+    {
+        std::vector<Entry> entries;
+        size_t limit = 2 * chunk;
+
+        for (uint64_t read = 0; read < partition.entries; ) {
+            size_t n = std::min<uint64_t>(chunk, partition.entries - read);
+            size_t used = entries.size();
+
+            entries.resize(used + n);
+
+            if (!read_all(partition.fd, reinterpret_cast<char *>(&entries[used]),
+                          n * sizeof(Entry), read * sizeof(Entry))) {
+                return false;
+            }
+
+            read += n;
+
+            if (entries.size() >= limit) {
+                collapse(entries);
+                limit = std::max(limit, 2 * entries.size());
+            }
+        }
+
+        collapse(entries);
+
+        for (auto & e: entries) {
+            this->classes[e.count == 1 ? 0 : 64 - __builtin_clzll(e.count - 1)]++;
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry & a, const Entry & b) {
+            return a.offset < b.offset;
+        });
+
+        partition.kept = entries.size();
+
+        if (ftruncate(partition.fd, 0) != 0 || lseek(partition.fd, 0, SEEK_SET) != 0) {
+            return false;
+        }
+
+        return write_all(partition.fd, reinterpret_cast<const char *>(entries.data()),
+                         entries.size() * sizeof(Entry));
+    }
+
+    // Each thread reads at most half of share at a time.
+    void
+    Dedup::deduplicate(
+        size_t threads,
+        uint64_t share)
+    {
+        size_t chunk = std::max<uint64_t>(MERGE_ENTRIES, share / sizeof(Entry) / 2);
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+
+        for (size_t t = 0; t < threads; t++) {
+            workers.push_back(std::thread([this, &next, chunk]() {
+                for (size_t i = next++; i < this->partitions.size() && !this->failed; i = next++) {
+                    if (!deduplicate(*this->partitions[i], chunk)) {
+                        std::perror("partition");
+                        this->failed = true;
+                    }
+                }
+            }));
+        }
+
+        for (auto & w: workers) {
+            w.join();
+        }
+    }
+
+    // Merges the kept entries of the partitions back into input order.
+    bool
+    Dedup::merge(
+        int out,
+        bool canonical)
+    {
+        struct Cursor {
+            std::vector<Entry> entries;
+            size_t position;
+            uint64_t read;
+        };
+
+        auto later = [](const std::pair<uint64_t, size_t> & a,
+                        const std::pair<uint64_t, size_t> & b) {
+            return a.first > b.first;
+        };
+
+        std::vector<Cursor> cursors(this->partitions.size());
+        std::priority_queue<std::pair<uint64_t, size_t>,
+                            std::vector<std::pair<uint64_t, size_t>>,
+                            decltype(later)> heap(later);
+
+        // Refills the buffer of a partition once it is used up.
+        auto advance = [&](size_t i) {
+            auto & c = cursors[i];
+            auto & partition = *this->partitions[i];
+
+            if (++c.position < c.entries.size()) {
+                heap.push({ c.entries[c.position].offset, i });
+                return true;
+            }
+
+            size_t n = std::min<uint64_t>(MERGE_ENTRIES, partition.kept - c.read);
+
+            c.entries.resize(n);
+            c.position = 0;
+
+            if (n == 0) {
+                return true;
+            }
+
+            if (!read_all(partition.fd, reinterpret_cast<char *>(c.entries.data()),
+                          n * sizeof(Entry), c.read * sizeof(Entry))) {
+                return false;
+            }
+
+            c.read += n;
+            heap.push({ c.entries[0].offset, i });
+            return true;
+        };
+
+        for (size_t i = 0; i < cursors.size(); i++) {
+            cursors[i].position = 0;
+            cursors[i].read = 0;
+
+            if (!advance(i)) {
+                return false;
+            }
+        }
+
+        const size_t line_length = RECORD_LENGTH + 1;
+        std::vector<char> buffer(MERGE_ENTRIES * 64 * line_length);
+        size_t used = 0;
+
+        while (!heap.empty()) {
+            size_t i = heap.top().second;
+            auto & entry = cursors[i].entries[cursors[i].position];
+            char * line = &buffer[used];
+
+            heap.pop();
+
+            if (canonical) {
+                packed::unpack(entry.form, line);
+            } else {
+                uint64_t offset = entry.offset;
+                const char * p = this->input.get_data() + offset;
+
+                read_record(offset, p, line);
+            }
+
+            line[RECORD_LENGTH] = '\n';
+            used += line_length;
+
+            if (used == buffer.size()) {
+                if (!write_all(out, buffer.data(), used)) {
+                    return false;
+                }
+                used = 0;
+            }
+
+            if (!advance(i)) {
+                return false;
+            }
+        }
+
+        return write_all(out, buffer.data(), used);
+    }
+
+    void
+    Dedup::summary() const
+    {
+        uint64_t puzzles = 0;
+        uint64_t classes = 0;
+
+        for (auto & p: this->partitions) {
+            puzzles += p->puzzles;
+            classes += p->kept;
+        }
+
+        std::fprintf(stderr, "%llu puzzles, %llu malformed, %llu classes\n",
+                     static_cast<unsigned long long>(puzzles),
+                     static_cast<unsigned long long>(this->malformed.load()),
+                     static_cast<unsigned long long>(classes));
+
+        for (size_t b = 0; b < BUCKETS; b++) {
+            if (this->classes[b] == 0) {
+                continue;
+            }
+
+            uint64_t low = b == 0 ? 1 : (uint64_t(1) << (b - 1)) + 1;
+            uint64_t high = uint64_t(1) << b;
+
+            if (low == high) {
+                std::fprintf(stderr, "  %llu classes of %llu\n",
+                             static_cast<unsigned long long>(this->classes[b].load()),
+                             static_cast<unsigned long long>(low));
+            } else {
+                std::fprintf(stderr, "  %llu classes of %llu-%llu\n",
+                             static_cast<unsigned long long>(this->classes[b].load()),
+                             static_cast<unsigned long long>(low),
+                             static_cast<unsigned long long>(high));
+            }
+        }
+    }
+}
+
+int
+main(
+    int argc,
+    char ** argv)
+{
+    size_t threads = 0;
+    size_t megabytes = 1024;
+    const char * tmpdir = std::getenv("TMPDIR");
+    std::string directory = tmpdir != nullptr ? tmpdir : "/tmp";
+    bool canonical = false;
+    bool quiet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:m:t:cq")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'm':
+            megabytes = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            directory = optarg;
+            break;
+        case 'c':
+            canonical = true;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind + 1 != argc && optind + 2 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (threads == 0) {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    MappedFile input;
+
+    if (!input.open(argv[optind])) {
+        std::fprintf(stderr, "%s\n", input.get_error().c_str());
+        return 1;
+    }
+
+    // Every thread holds a partition while deduplicating, with room
+    // for a partition a quarter over its share.  With too many
+    // partitions fewer threads deduplicate them.
+    bool is_packed = packed::is_packed(input.get_data(), input.size());
+    uint64_t records = input.size() / (is_packed ? packed::PACKED_LENGTH : RECORD_LENGTH + 1) + 1;
+    uint64_t budget = std::max<uint64_t>(1, megabytes) << 20;
+    uint64_t bytes = records * sizeof(Entry) * 5 / 4;
+    uint64_t partitions = std::min<uint64_t>(MAX_PARTITIONS, bytes * threads / budget + 1);
+    uint64_t share = bytes / partitions + 1;
+
+    if (share > budget) {
+        std::fprintf(stderr, "The input needs more than %zu megabytes\n",
+                     static_cast<size_t>((share >> 20) + 1));
+        return 1;
+    }
+
+    int out = STDOUT_FILENO;
+
+    if (optind + 2 == argc) {
+        out = ::open(argv[optind + 1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (out < 0) {
+            std::perror(argv[optind + 1]);
+            return 1;
+        }
+    }
+
+    Dedup dedup(input, threads);
+
+    if (!dedup.open(partitions, directory)) {
+        return 1;
+    }
+
+    dedup.partition();
+
+    if (!dedup.is_failed()) {
+        dedup.deduplicate(std::min<uint64_t>(threads, budget / share), share);
+    }
+
+    if (dedup.is_failed()) {
+        return 1;
+    }
+
+    if (!dedup.merge(out, canonical)) {
+        std::perror("write");
+        return 1;
+    }
+
+    if (!quiet) {
+        dedup.summary();
+    }
+
+    return 0;
+}
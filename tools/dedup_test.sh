@@ -0,0 +1,56 @@
+#!/bin/sh
+# Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero General Public License as
+#  published by the Free Software Foundation, version 3 of the
+#  License.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero General Public License for more details.
+#
+#  You should have received a copy of the GNU Affero General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+# The 17-clue corpus is 20 puzzles followed by 80 isomorphs of them,
+# four of each.  Deduplicating it, once as is and once repeated many
+# times over, keeps the 20 puzzles in input order.
+
+set -e
+
+srcdir=${srcdir:-.}
+dedup=./sudokucpp-dedup
+work=dedup_test.$$
+
+trap 'rm -rf $work' EXIT
+mkdir $work
+
+grep -v '^#' $srcdir/../bench/corpora/17clue.txt > $work/corpus.txt
+head -n 20 $work/corpus.txt > $work/expected.txt
+
+fail() {
+    echo "FAIL: $1" >&2
+    exit 1
+}
+
+$dedup -j 2 $work/corpus.txt $work/out.txt 2> $work/summary.txt
+cmp -s $work/expected.txt $work/out.txt || fail "corpus: output"
+grep -q '^100 puzzles, 0 malformed, 20 classes$' $work/summary.txt || fail "corpus: classes"
+grep -q '^  20 classes of 5-8$' $work/summary.txt || fail "corpus: class sizes"
+
+# 50000 puzzles in 20 classes through small partitions.
+i=0
+while [ $i -lt 500 ]; do
+    cat $work/corpus.txt
+    i=$((i + 1))
+done > $work/repeated.txt
+
+$dedup -j 2 -m 1 $work/repeated.txt $work/out.txt 2> $work/summary.txt
+cmp -s $work/expected.txt $work/out.txt || fail "repeated: output"
+grep -q '^50000 puzzles, 0 malformed, 20 classes$' $work/summary.txt || fail "repeated: classes"
+grep -q '^  20 classes of 2049-4096$' $work/summary.txt || fail "repeated: class sizes"
+
+exit 0
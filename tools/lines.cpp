@@ -0,0 +1,61 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+
+#include "sudokucpp/batch.h"
+#include "lines.h"
+
+using namespace sudoku;
+
+size_t
+count_lines(
+    const char * p,
+    const char * end)
+{
+    size_t lines = 0;
+
+    for (; p < end; lines++) {
+        const char * eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+
+        p = eol != nullptr ? eol + 1 : end;
+    }
+
+    return lines;
+}
+
+const char *
+pack_line(
+    const char * p,
+    const char * end,
+    char * record)
+{
+    const char * eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    const char * next = eol != nullptr ? eol + 1 : end;
+    size_t length = (eol != nullptr ? eol : end) - p;
+
+    if (length > 0 && p[length - 1] == '\r') {
+        length--;
+    }
+
+    if (length == RECORD_LENGTH) {
+        std::memcpy(record, p, RECORD_LENGTH);
+    } else {
+        std::memset(record, '?', RECORD_LENGTH);
+    }
+
+    return next;
+}
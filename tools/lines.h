@@ -0,0 +1,30 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LINES_H
+#define LINES_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Number of lines in [p, end), counting a last line without a newline.
+size_t count_lines(const char * p, const char * end);
+
+// Copies the next line to a packed record, or '?' characters when it
+// is not a puzzle.  Returns the start of the following line.
+const char * pack_line(const char * p, const char * end, char * record);
+
+#endif
@@ -0,0 +1,46 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+
+#include "options.h"
+
+using namespace sudoku;
+
+bool
+parse_backend(
+    const char * name,
+    Backend & backend)
+{
+    const struct {
+        const char * name;
+        Backend backend;
+    } backends[] = {
+        { "backtracking", Backend::Backtracking },
+        { "dlx", Backend::DancingLinks },
+        { "bitboard", Backend::Bitboard },
+        { "cdcl", Backend::Cdcl }
+    };
+
+    for (auto & b: backends) {
+        if (std::strcmp(name, b.name) == 0) {
+            backend = b.backend;
+            return true;
+        }
+    }
+
+    return false;
+}
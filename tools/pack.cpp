@@ -0,0 +1,144 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+#include "sudokucpp/mapped_file.h"
+#include "sudokucpp/packed.h"
+#include "lines.h"
+
+using namespace sudoku;
+
+namespace {
+    // An output line: the record and a newline.
+    const size_t LINE_LENGTH = RECORD_LENGTH + 1;
+
+    void
+    usage(
+        const char * name)
+    {
+        std::fprintf(stderr,
+                     "Usage: %s [-d] input output\n"
+                     "\n"
+                     "Converts a file of puzzles, one per line, to the packed binary\n"
+                     "format of %zu bytes per puzzle.  Malformed lines are stored as\n"
+                     "invalid records.\n"
+                     "\n"
+                     "  -d  convert a packed file back to lines\n",
+                     name, packed::PACKED_LENGTH);
+    }
+
+    int
+    pack_file(
+        const MappedFile & input,
+        const std::string & output_path)
+    {
+        const char * p = input.get_data();
+        const char * end = p + input.size();
+        size_t lines = count_lines(p, end);
+        MappedFile output;
+
+        if (!output.create(output_path, packed::file_size(lines))) {
+            std::fprintf(stderr, "%s\n", output.get_error().c_str());
+            return 1;
+        }
+
+        packed::Writer writer(output.get_data(), lines);
+        char record[RECORD_LENGTH];
+        size_t invalid = 0;
+
+        for (size_t i = 0; i < lines; i++) {
+            p = pack_line(p, end, record);
+            invalid += !writer.set(i, record);
+        }
+
+        if (invalid > 0) {
+            std::fprintf(stderr, "%zu malformed lines\n", invalid);
+        }
+
+        return 0;
+    }
+
+    int
+    unpack_file(
+        const MappedFile & input,
+        const std::string & output_path)
+    {
+        try {
+            packed::Reader reader(input.get_data(), input.size());
+            MappedFile output;
+
+            if (!output.create(output_path, reader.size() * LINE_LENGTH)) {
+                std::fprintf(stderr, "%s\n", output.get_error().c_str());
+                return 1;
+            }
+
+            char * dest = output.get_data();
+
+            for (size_t i = 0; i < reader.size(); i++) {
+                reader.get(i, dest + i * LINE_LENGTH);
+                dest[i * LINE_LENGTH + RECORD_LENGTH] = '\n';
+            }
+        } catch (const std::invalid_argument & e) {
+            std::fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+
+        return 0;
+    }
+}
+
+int
+main(
+    int argc,
+    char ** argv)
+{
+    bool unpack = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d")) != -1) {
+        switch (opt) {
+        case 'd':
+            unpack = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind + 2 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    MappedFile input;
+
+    if (!input.open(argv[optind])) {
+        std::fprintf(stderr, "%s\n", input.get_error().c_str());
+        return 1;
+    }
+
+    if (unpack) {
+        return unpack_file(input, argv[optind + 1]);
+    }
+
+    return pack_file(input, argv[optind + 1]);
+}
@@ -0,0 +1,283 @@
+// -*- C++ -*-
+// Copyright (c) 2019 Jani J. Hakala <jjhakala@gmail.com> Finland
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "sudokucpp/mapped_file.h"
+#include "sudokucpp/packed.h"
+#include "sudokucpp/parallel.h"
+#include "sudokucpp/pipeline.h"
+#include "lines.h"
+#include "options.h"
+
+using namespace sudoku;
+
+namespace {
+    // An output line: the record and a newline.
+    const size_t LINE_LENGTH = RECORD_LENGTH + 1;
+
+    // Records handed to the pool at a time.
+    const size_t CHUNK_RECORDS = 1 << 16;
+
+    // Slots of a store created by -S.
+    const size_t STORE_SLOTS = 1 << 22;
+
+    const char * status_names[] = {
+        "unsolved", "solved", "contradiction", "timed out", "cancelled", "invalid"
+    };
+
+    void
+    usage(
+        const char * name)
+    {
+        std::fprintf(stderr,
+                     "Usage: %s [-j threads] [-b backend] [-n steps] [-c entries]\n"
+                     "          [-s store | -S store] [-o output] [-q] [input]\n"
+                     "\n"
+                     "Solves a file of puzzles, one per line or in the packed format of\n"
+                     "sudokucpp-pack, and writes one line of %zu characters for each:\n"
+                     "the solution, or the puzzle itself when it is not solved.\n"
+                     "Malformed puzzles come out as '?' characters.\n"
+                     "Without an input file, or with -, streams from stdin to stdout.\n"
+                     "\n"
+                     "  -j threads  solver threads, one per hardware thread by default\n"
+                     "  -b backend  backtracking, dlx, bitboard (default) or cdcl\n"
+                     "  -n steps    search step budget per puzzle\n"
+                     "  -c entries  cache the solutions of puzzles and their symmetric\n"
+                     "              variants\n"
+                     "  -s store    look puzzles up in a solution store\n"
+                     "  -S store    look up and add solutions, creating the store if needed\n"
+                     "  -o output   write into a memory mapped file instead of stdout\n"
+                     "  -q          no summary on stderr\n",
+                     name, RECORD_LENGTH);
+    }
+
+    const size_t STATUSES = sizeof(status_names) / sizeof(status_names[0]);
+
+    void
+    summary(
+        size_t puzzles,
+        const size_t * counts,
+        const SolutionCache * cache)
+    {
+        std::fprintf(stderr, "%zu puzzles", puzzles);
+
+        for (size_t i = 0; i < STATUSES; i++) {
+            if (counts[i] > 0) {
+                std::fprintf(stderr, ", %zu %s", counts[i], status_names[i]);
+            }
+        }
+
+        if (cache != nullptr) {
+            std::fprintf(stderr, ", %zu cache hits", cache->get_hits());
+        }
+
+        std::fprintf(stderr, "\n");
+    }
+
+    int
+    stream(
+        Backend backend,
+        size_t threads,
+        size_t steps,
+        std::shared_ptr<SolutionCache> cache,
+        std::shared_ptr<SolutionStore> store,
+        bool quiet)
+    {
+        Pipeline pipeline(backend, threads);
+
+        pipeline.set_step_budget(steps);
+        pipeline.set_cache(cache);
+        pipeline.set_store(store);
+
+        if (!pipeline.run(STDIN_FILENO, STDOUT_FILENO)) {
+            std::perror("sudokucpp-solve");
+            return 1;
+        }
+
+        if (!quiet) {
+            size_t counts[STATUSES];
+            size_t puzzles = 0;
+
+            for (size_t i = 0; i < STATUSES; i++) {
+                counts[i] = pipeline.get_count(static_cast<Status>(i));
+                puzzles += counts[i];
+            }
+
+            summary(puzzles, counts, cache.get());
+        }
+
+        return 0;
+    }
+}
+
+int
+main(
+    int argc,
+    char ** argv)
+{
+    size_t threads = 0;
+    size_t steps = 0;
+    std::shared_ptr<SolutionCache> cache;
+    std::shared_ptr<SolutionStore> store;
+    Backend backend = Backend::Bitboard;
+    std::string output_path;
+    bool quiet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:b:n:c:s:S:o:q")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'b':
+            if (!parse_backend(optarg, backend)) {
+                std::fprintf(stderr, "Unknown backend %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            steps = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'c':
+            cache = std::make_shared<SolutionCache>(std::strtoul(optarg, nullptr, 10));
+            break;
+        case 's':
+        case 'S':
+            store = std::make_shared<SolutionStore>();
+
+            if (opt == 's' ? !store->open(optarg) : !store->open_writable(optarg, STORE_SLOTS)) {
+                std::fprintf(stderr, "%s: %s\n", optarg, store->get_error().c_str());
+                return 1;
+            }
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind + 1 < argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (optind == argc || std::strcmp(argv[optind], "-") == 0) {
+        if (!output_path.empty()) {
+            std::fprintf(stderr, "Streaming writes to stdout, -o needs an input file\n");
+            return 1;
+        }
+
+        return stream(backend, threads, steps, cache, store, quiet);
+    }
+
+    MappedFile input;
+
+    if (!input.open(argv[optind])) {
+        std::fprintf(stderr, "%s\n", input.get_error().c_str());
+        return 1;
+    }
+
+    const char * p = input.get_data();
+    const char * end = p + input.size();
+    std::unique_ptr<packed::Reader> reader;
+    size_t lines;
+
+    if (packed::is_packed(p, input.size())) {
+        try {
+            reader.reset(new packed::Reader(p, input.size()));
+        } catch (const std::invalid_argument & e) {
+            std::fprintf(stderr, "%s: %s\n", argv[optind], e.what());
+            return 1;
+        }
+
+        lines = reader->size();
+    } else {
+        lines = count_lines(p, end);
+    }
+
+    MappedFile output;
+
+    if (!output_path.empty() && !output.create(output_path, lines * LINE_LENGTH)) {
+        std::fprintf(stderr, "%s\n", output.get_error().c_str());
+        return 1;
+    }
+
+    ParallelBatchSolver pool(backend, threads);
+
+    pool.set_step_budget(steps);
+    pool.set_cache(cache);
+    pool.set_store(store);
+
+    std::vector<char> records(CHUNK_RECORDS * RECORD_LENGTH);
+    std::vector<char> solved(CHUNK_RECORDS * RECORD_LENGTH);
+    std::vector<char> buffer(output_path.empty() ? CHUNK_RECORDS * LINE_LENGTH : 0);
+    std::vector<Status> status(CHUNK_RECORDS);
+    size_t counts[STATUSES] = {};
+    size_t done = 0;
+
+    while (done < lines) {
+        size_t n = 0;
+
+        if (reader) {
+            n = std::min(CHUNK_RECORDS, lines - done);
+            reader->get_batch(done, n, records.data());
+        }
+
+        while (!reader && p < end && n < CHUNK_RECORDS) {
+            p = pack_line(p, end, &records[n * RECORD_LENGTH]);
+            n++;
+        }
+
+        pool.solve_batch(records.data(), n, solved.data(), status.data());
+
+        char * dest = output_path.empty()
+            ? buffer.data() : output.get_data() + done * LINE_LENGTH;
+
+        for (size_t i = 0; i < n; i++) {
+            std::memcpy(dest + i * LINE_LENGTH, &solved[i * RECORD_LENGTH], RECORD_LENGTH);
+            dest[i * LINE_LENGTH + RECORD_LENGTH] = '\n';
+            counts[static_cast<size_t>(status[i])]++;
+        }
+
+        if (output_path.empty() && !write_all(STDOUT_FILENO, dest, n * LINE_LENGTH)) {
+            std::perror("write");
+            return 1;
+        }
+
+        done += n;
+    }
+
+    if (!quiet) {
+        summary(done, counts, cache.get());
+    }
+
+    return 0;
+}